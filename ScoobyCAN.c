@@ -7,8 +7,10 @@
  * (at your option) any later version.
  */
 
+#define _GNU_SOURCE // recvmmsg()
 #include <stdio.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
@@ -20,30 +22,126 @@
 #include <sys/ioctl.h>
 #include <curses.h>
 #include <endian.h>
+#include <math.h>
 // try and get timestamps
 #include <time.h>
 #include <sys/time.h>
+// batched receive and clean shutdown
+#include <signal.h>
+#include <errno.h>
+#include <sys/resource.h>
+// rendering runs in its own thread
+#include <pthread.h>
+#include <sched.h>
+// hardware counters for benchmarks
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+// replaying logs from file
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <limits.h>
+// several buses at once
+#include <sys/epoll.h>
+// receiver and decoder thread
+#include <sys/eventfd.h>
+#include <linux/futex.h>
+// wide loads for parsing logs
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+// publishing values to other processes
+#include "ScoobyCAN_shm.h"
 
-static void unknown_frame(int);
-static void process_one(struct can_frame *frm);
-static int ncurses_init(void);
+struct bus;
+struct frame_plan;
+struct ring_slot;
+static void unknown_frame(struct bus *b, struct can_frame *frm, uint64_t now);
+static void unknown_summary(struct bus *b);
+static void report_unknown(struct bus *b, FILE *out);
+static void process_one(struct bus *b, struct can_frame *frm, const struct timeval *stamp);
+static void report_timing(struct bus *b, FILE *out);
+static int decoder_init(const char *dbc);
+static int dbc_load(const char *fname);
+static void post_vcds_speeds(struct bus *b);
+static void post_ecu_600(struct bus *b);
+static int ncurses_init(int null_term);
 static int paint_empty_scr(void);
-static int tpms_check(int *tpms_flag);
-static int mem_init(void);
-static int net_init(char *ifname);
-static void receive_one(void);
+static void render(struct bus *b);
+static void render_start(void);
+static void render_stop(void);
+static void tpms_update(struct bus *b, uint64_t now);
+static struct bus *bus_new(const char *name);
+static void mem_init(struct bus *b);
+static int net_init(struct bus *b);
+static int can_open(const char *ifname);
+static int receive_batch(struct bus *b);
+static void receive_start(void);
+static void receive_stop(void);
+static void decode_loop(void);
+static void sample_unknown(struct bus *b);
+static void print_recv_stats(void);
+static int parse_candump(const char **pos, const char *end,
+      struct can_frame *frm, struct timeval *stamp, const char **ifname, int *iflen);
+static int parse_candump_scalar(const char **pos, const char *end,
+      struct can_frame *frm, struct timeval *stamp, const char **ifname, int *iflen);
+static int replay_file(const char *fname, double speed, double from, double to);
+static int analyse_file(const char *fname, int nthreads);
+static void play_match(const struct ring_slot *slot);
+#ifdef PROF
+static void prof_report(FILE *out);
+static void prof_poll(void);
+#endif
+static void print_columns(const char *bus, const struct timeval *stamp,
+      const int32_t *ints, const float *floats, const bool *sw);
+static void print_window(struct bus *b, int win, const struct timeval *stamp);
+static void dump_flush(void);
+static int record_open(struct bus *b, const char *fname);
+static void record_one(struct bus *b, uint64_t now);
+static int record_close(struct bus *b);
+static int shm_open_bus(struct bus *b, const char *name);
+static void shm_publish(struct bus *b, const struct frame_plan *f, uint64_t now);
+static void shm_close(struct bus *b);
+static int record_print(const char *fname, double from, double to);
+static int bench_file(const char *fname, int scale);
 int main(int argc, char **argv);
 
-#define __packed __attribute__((packed))
-#define rbi(b,n) ((b) & (1<<(n)))           /* Read bit number n in byte b    */
 
 // set up a fudge factor to guess better fuelconsumption
 #define FUELFUDGE 64.
 
-// define steering wheel angle after which we ignore TPMS guess
-//#define TPMS_STEER_LIMIT 5
-// define number of times we need to trigger TPMS guess before we print warning
-//#define TPMS_COUNT_LIMIT 500
+// TPMS guess: we only judge wheel speeds going straight (steering angle in
+// degrees), not too slow (km/h) and not speeding up or braking hard (g)
+// these are the defaults, -T sets them at runtime
+#ifndef TPMS_STEER_LIMIT
+#define TPMS_STEER_LIMIT 5
+#endif
+#define TPMS_MIN_SPEED 20.
+#define TPMS_ACCEL_LIMIT 0.1
+// time constant of the averaged wheel speed ratios (s)
+#define TPMS_TAU 30.
+// a wheel this much faster than the mean looks low on pressure, and looks
+// fine again below half of it
+#define TPMS_WARN_RATIO 0.015
+// seconds of judged driving a wheel has to look low before we warn
+#define TPMS_WARN_TIME 60.
+static struct tpms_config {
+   double steer_limit;
+   double min_speed;
+   double accel_limit;
+   double tau;
+   double warn_ratio;
+   double warn_time;
+} tpms_cfg = {
+   TPMS_STEER_LIMIT, TPMS_MIN_SPEED, TPMS_ACCEL_LIMIT,
+   TPMS_TAU, TPMS_WARN_RATIO, TPMS_WARN_TIME
+};
+// their names for -T
+static char *const tpms_keys[] = { "steer", "speed", "accel", "tau", "ratio", "time", NULL };
+static double *const tpms_settings[] = {
+   &tpms_cfg.steer_limit, &tpms_cfg.min_speed, &tpms_cfg.accel_limit,
+   &tpms_cfg.tau, &tpms_cfg.warn_ratio, &tpms_cfg.warn_time
+};
 
 // minimal size for ncurses window
 #define LINES 35
@@ -58,6 +156,7 @@ int main(int argc, char **argv);
 #define TORQUE_LINE 16
 #define ACCEL_LINE 19
 #define MINMAX_LINE 22
+#define TRIP_LINE 25
 #define SWITCHES_LINE -4
 #define LEFT_WHL 25
 #define MID_WHL 42
@@ -70,14 +169,81 @@ int main(int argc, char **argv);
 #define HEADING 1
 #define WARN 2
 #define HIL 3
+// screen updates per second
+#define RENDER_HZ_DEFAULT 20
+
+// max number of frames we pull from the socket with one recvmmsg()
+#define RECV_BATCH_MAX 256
+#define RECV_BATCH_DEFAULT 32
+// frames the receiver thread can queue up for the decoder, a power of two
+#define RING_SIZE 16384
+// threads an offline analysis of a log runs on at most
+#define ANALYSE_THREADS_MAX 256
+
+// unknown frames: standard IDs are indexed directly, extended ones are hashed
+// into a table of UNKNOWN_EXT_COUNT entries
+#define UNKNOWN_EXT_BITS 10
+#define UNKNOWN_EXT_COUNT (1 << UNKNOWN_EXT_BITS)
+#define UNKNOWN_COUNT (CAN_SFF_MASK + 1 + UNKNOWN_EXT_COUNT)
+// how often we refresh the unknown summary, once a second in render ticks
+// at whatever rate -R set
+#define UNKNOWN_SUMMARY_TICKS render_hz
+// in known-only mode, how often we drain the sampling socket (us) and
+// how much it may queue in between (bytes)
+#define UNKNOWN_SAMPLE_US 1000000
+#define UNKNOWN_SAMPLE_RCVBUF 4096
+
+// everything we keep about an ID we do not know how to interpret
+struct unknown_id {
+   canid_t id;         // incl. CAN_EFF_FLAG, 0 marks a free hash slot
+   uint32_t count;     // frames seen
+   uint64_t first_us;  // timestamp of first and last frame
+   uint64_t last_us;
+   uint8_t dlc;        // last payload
+   uint8_t data[CAN_MAX_DLEN];
+   struct unknown_rev *rev;  // payload analysis with -u, else NULL
+};
 
-// limit on the unknown frames, for non-extended CAN this is < 0x800
-#define UNKNOWN_COUNT 1024
-static int unknown[UNKNOWN_COUNT];
+// payload analysis of unknown IDs, to help work out what they carry
+// per bit counts go into bit-sliced counters first: plane k holds bit k
+// of 64 counters side by side, so counting a word of flags takes a few
+// ANDs and XORs, and every REV_FLUSH frames the planes go into plain ones
+#define REV_PLANES 8
+#define REV_FLUSH ((1 << REV_PLANES) - 1)
+// what the events word of a frame flags, at these bits of every byte
+#define REV_NIBBLE_HI 7  // the high nibble went up by one
+#define REV_BYTE 6       // the byte went up by one
+#define REV_SUM 5        // the byte is the sum of the other bytes
+#define REV_SUM_ID 4     // the same, plus the bytes of the ID
+#define REV_NIBBLE_LO 3  // the low nibble went up by one
+// candidate signals: each byte, each little and each big endian 16 bit word
+#define REV_CANDIDATES (CAN_MAX_DLEN + 2 * (CAN_MAX_DLEN - 1))
+// known signals the candidates are correlated with, see rev_ref()
+#define REV_REFS 2
+// how sure we need to be before we say so
+#define REV_MIN_FRAMES 16
+#define REV_SHARE 0.95
+#define REV_MIN_R 0.9
+struct unknown_rev {
+   uint64_t first, last;      // payloads as little endian words
+   uint32_t frames, pending;  // pending: counts still in the planes
+   uint32_t xor_zero;         // frames whose bytes XOR to 0
+   uint8_t dlc;               // the longest payload
+   uint8_t first_dlc;
+   uint64_t toggle_planes[REV_PLANES];
+   uint64_t event_planes[REV_PLANES];
+   uint32_t toggles[64];      // per bit, times it changed
+   uint32_t events[64];       // per bit of the events word
+   uint64_t values[CAN_MAX_DLEN][4];  // per byte, the values seen
+   // sums for the correlations, over the frames that came once the
+   // reference was decoded
+   double n[REV_REFS], sy[REV_REFS], syy[REV_REFS];
+   double sx[REV_REFS][REV_CANDIDATES];
+   double sxx[REV_REFS][REV_CANDIDATES];
+   double sxy[REV_REFS][REV_CANDIDATES];
+};
 
 int row, col; // global size of our window
-int display;  // this controlls how often we update the screen or output data
-int tpms_flag[4]; // this will hold data on TPMS module
 
 // ENUM the frame IDs we know are present or know how to interpret
 enum frame_ids {
@@ -103,7 +269,9 @@ enum switch_data {
    DOOR_SW,
    SWITCH_COUNT
 };
-bool switches[SWITCH_COUNT];
+static const char *switch_names[SWITCH_COUNT] = {
+   "BREAK_SW", "CLUTCH_SW", "DOOR_SW"
+};
 
 // index floats we want to use
 enum float_data {
@@ -120,8 +288,10 @@ enum float_data {
    TORQ_LOSS,       // col 17
    FLOAT_COUNT
 };
-float float_mem[FLOAT_COUNT];
-float maxf, minf, minax, maxax, minay, maxay;
+static const char *float_names[FLOAT_COUNT] = {
+   "ACCEL", "A_X", "A_Y", "SPEED", "SPEED_F_L", "SPEED_F_R", "SPEED_R_L",
+   "SPEED_R_R", "TRANS_TORQ", "ENGINE_TORQ", "TORQ_LOSS"
+};
 
 // index ints we want to use
 enum int_data {
@@ -132,739 +302,5420 @@ enum int_data {
    GEAR,            // col 6
    INT_COUNT
 };
-int32_t int_mem[INT_COUNT];
-
-// a union to access the frame content, same memory, different interpretation
-union u_frames {
-   struct __packed { // 0x002
-      int16_t angle;
-      uint8_t byte2;
-      uint8_t byte3;
-      uint8_t byte4;
-      uint8_t byte5;
-      uint8_t byte6;
-      uint8_t byte7;
-   } steering_sensor;
-   struct __packed { // 0x070
-      uint16_t yaw_rate;
-      //
-      uint8_t byte2;
-      uint8_t byte3;
-      uint16_t y_accel;
-      //
-      	//uint16_t counter;
-      uint8_t byte6;
-      uint8_t byte7;
-   } vcds_y;
-   struct __packed { // 0x080
-      uint16_t yaw_accel;
-      //
-      uint8_t byte2;
-      uint8_t byte3;
-      uint16_t x_accel;
-      //
-     	 //uint16_t counter;
-      uint8_t byte6;
-      uint8_t byte7;
-   } vcds_x;
-   struct __packed { // 0x410
-      uint8_t byte0;
-      uint8_t transtorq;
-      uint8_t engtorq;
-      uint8_t torqloss;
-      uint8_t accel;
-      uint16_t rpm;
-      //
-      uint8_t byte7;
-   } ecu_410;
-   struct __packed { // 0x411
-      uint8_t byte0;
-      uint16_t le;
-      //
-      uint8_t byte3;
-      uint8_t gear;
-      uint8_t cruisespeed;
-      uint8_t byte6;
-      uint8_t byte7;
-   } ecu_411;
-   struct __packed { // 0x501
-      uint8_t byte0;
-      uint8_t byte1;
-      uint8_t torqreduction;
-      uint8_t torqallow;
-      uint8_t torqdown;
-      uint8_t _counter;
-      uint8_t byte6;
-      uint8_t byte7;
-   } vcds_torq;
-   struct __packed { // 0x511
-      int16_t angle;
-      //
-      uint8_t byte2;
-      uint8_t byte3;
-      uint8_t byte4;
-      uint8_t byte5;
-      uint8_t byte6;
-      uint8_t byte7;
-   } vcds_steering_sensor;
-   struct __packed { // 0x512
-      uint8_t byte0;
-      uint8_t byte1;
-      int16_t speed;
-      uint8_t byte5;
-      uint8_t counter;
-      uint16_t fcode;
-      //
-   } vcds_speed;
-   struct __packed { // 0x513
-      int16_t frle;
-      //
-      int16_t frri;
-      //
-      int16_t rele;
-      //
-      int16_t reri;
-      //
-   } vcds_speeds;
-   struct __packed { // 0x514
-      uint8_t byte0;
-      uint8_t byte1;
-      int16_t temp;
-      //
-      uint8_t leftlever;
-      uint8_t fuel;
-      uint8_t counter;
-   } biu_temp;
-   struct __packed { // 0x600
-      uint8_t dpf_bits;
-      uint16_t fuel;
-      //
-      uint8_t coolant;
-      uint8_t counter;
-      uint8_t byte5;
-      uint8_t clutch_bits;
-      uint8_t byte7;
-   } ecu_600;
-   struct __packed {
-      uint8_t byte0;
-      uint8_t byte1;
-      uint8_t byte2;
-      uint8_t byte3;
-      uint8_t byte4;
-      uint8_t byte5;
-      uint8_t byte6;
-      uint8_t byte7;
-   } biu_620;
-   struct __packed {
-      uint8_t byte0;
-      uint8_t byte1;
-      uint8_t byte2;
-      uint8_t byte3;
-      uint8_t byte4;
-      uint8_t byte5;
-      uint8_t byte6;
-      uint8_t byte7;
-   } raw;
-};
-
-static int can_socket;
-struct timeval tv;
+static const char *int_names[INT_COUNT] = {
+   "STEER_VAL", "STEER_ANGLE", "RPM", "FUEL", "GEAR"
+};
 
-// functions start here
-//
-// deal with unknown frames
-static void unknown_frame(int id)
-{
-	int i;
-
-	for (i = 0; i < UNKNOWN_COUNT; i++)
-		if (unknown[i] == 0 || unknown[i] == id)
-			break;
-	if (i == UNKNOWN_COUNT)
-		return;
-
-	unknown[i] = id;
-
-#ifdef NCURS
-	move(row - 3, 1);
-	clrtoeol();
-	mvprintw(row - 3, 1, "unknown frames:");
-	for (i = 0; i < UNKNOWN_COUNT; i++) {
-		if (unknown[i] == 0)
-			break;
-		printw(" %02x", unknown[i]);
-	}
-	printw(" (%d)", i);
+// index values we only show on screen, they do not go into the dump columns
+enum aux_data {
+   YAW_RATE,
+   YAW_ACCEL,
+   Y_BYTE6,
+   Y_BYTE7,
+   X_BYTE6,
+   X_BYTE7,
+   SPEED_CNT,
+   AMB_TEMP,
+   TEMP_CNT,
+   COOLANT,
+   FUEL_CNT,
+   FUEL_LPH,
+   FUEL_L100KM,
+   AUX_COUNT
+};
+static const char *aux_names[AUX_COUNT] = {
+   "YAW_RATE", "YAW_ACCEL", "Y_BYTE6", "Y_BYTE7", "X_BYTE6", "X_BYTE7",
+   "SPEED_CNT", "AMB_TEMP", "TEMP_CNT", "COOLANT", "FUEL_CNT", "FUEL_LPH",
+   "FUEL_L100KM"
+};
+
+// what changed since the last repaint, one bit per slot
+// set by the decoder, taken and cleared by the renderer
+enum misc_data {
+   TPMS_FLAGS,
+   TRIP_DATA,
+   MISC_COUNT
+};
+
+// the trip computer integrates over frame time, but not across gaps in
+// the data longer than this
+#define TRIP_MAX_GAP_US 1000000
+enum trips {
+   TRIP_TOTAL,     // since we started
+   TRIP_A,         // since the last reset
+   TRIP_COUNT
+};
+static const char *trip_names[TRIP_COUNT] = { "since start", "trip" };
+
+// a TPMS sample that passed the gates, dt < 0 for the first one of a chunk
+struct tpms_sample {
+   uint64_t us;
+   float dt;
+   float r[4];
+};
+
+struct trip {
+   double fuel_l, dist_km;
+   double engine_s;  // engine running
+   double moving_s;  // wheels turning
+};
+
+// every int and float slot is aggregated, all time and over sliding windows
+// ints come first, then the floats, in agg[AGG_SLOTS] of each bus
+#define AGG_SLOTS (INT_COUNT + FLOAT_COUNT)
+// a window is a ring of AGG_BUCKETS buckets and slides a bucket at a time
+#define AGG_BUCKETS 10
+enum agg_windows {
+   AGG_1S,
+   AGG_10S,
+   AGG_60S,
+   AGG_WINDOWS
+};
+static const uint64_t agg_window_us[AGG_WINDOWS] = { 1000000, 10000000, 60000000 };
+static const char *agg_window_names[AGG_WINDOWS] = { "1s", "10s", "60s" };
+
+struct agg_bucket {
+   uint64_t epoch;      // start of the bucket in bucket lengths
+   uint32_t n;
+   float min, max;
+   double sum, sum2;
+};
+
+struct agg_window {
+   uint64_t end_us;     // when the current bucket is over
+   int cur;
+   struct agg_bucket bucket[AGG_BUCKETS];
+};
+
+struct agg {
+   uint64_t n;
+   float min, max;
+   double mean, m2;     // running mean and variance (Welford)
+   struct agg_window win[AGG_WINDOWS];
+};
+
+// what we know about a slot, all time or over a window
+struct agg_stats {
+   uint64_t n;
+   double min, max, mean, sd;
+};
+
+// where a decoded signal ends up
+enum sig_target {
+   T_INT,           // int_mem
+   T_FLOAT,         // float_mem
+   T_AUX,           // aux_mem
+   T_SWITCH,        // switches, any non-zero value is on
+   T_NONE           // known, but we do not keep it
+};
+#define SIG_SIGNED     0x01
+#define SIG_BIG_ENDIAN 0x02
+#define SIG_COUNTER    0x04  // rolling counter, checked for lost frames
+
+// a signal within a frame, value = raw * scale + offset
+// start and len follow DBC files: start is the bit number of the lsb for
+// little endian signals and of the msb for big endian ones, counting from
+// bit 0 of byte 0, len is the width in bits
+struct signal_def {
+   uint16_t id;
+   uint8_t start;
+   uint8_t len;
+   uint8_t flags;
+   double scale;
+   double offset;
+   uint8_t target;
+   uint8_t slot;
+};
+
+// the Subaru signals we know how to interpret, dbc/subaru.dbc describes the
+// same and make check fails if the two decode differently
+static const struct signal_def builtin_signals[] = {
+   // id                      start len flags                scale        offset    target    slot
+   { SUB_STEERING_SENSOR,        0, 16, SIG_SIGNED,             1.,          0.,     T_INT,    STEER_VAL },
+   { SUB_VCDS_Y,                 0, 16, 0,                      0.005,     -163.84,  T_AUX,    YAW_RATE },
+   { SUB_VCDS_Y,                32, 16, 0,                      0.00012742, -4.1768, T_FLOAT,  A_Y },
+   // hypothesis, byte 6 might be a counter
+   { SUB_VCDS_Y,                48,  8, 0,                      1.,          0.,     T_AUX,    Y_BYTE6 },
+   { SUB_VCDS_Y,                48,  4, SIG_COUNTER,            1.,          0.,     T_NONE,   0 },
+   { SUB_VCDS_Y,                56,  8, 0,                      1.,          0.,     T_AUX,    Y_BYTE7 },
+   { SUB_VCDS_X,                 0, 16, 0,                      0.125,   -4096.,     T_AUX,    YAW_ACCEL },
+   { SUB_VCDS_X,                32, 16, 0,                      0.00012742, -4.1768, T_FLOAT,  A_X },
+   { SUB_VCDS_X,                48,  8, 0,                      1.,          0.,     T_AUX,    X_BYTE6 },
+   { SUB_VCDS_X,                48,  4, SIG_COUNTER,            1.,          0.,     T_NONE,   0 },
+   { SUB_VCDS_X,                56,  8, 0,                      1.,          0.,     T_AUX,    X_BYTE7 },
+   { SUB_ECU_410,                8,  8, 0,                      1.6,         0.,     T_FLOAT,  TRANS_TORQ },
+   { SUB_ECU_410,               16,  8, 0,                      1.6,         0.,     T_FLOAT,  ENGINE_TORQ },
+   { SUB_ECU_410,               24,  8, 0,                      1.6,         0.,     T_FLOAT,  TORQ_LOSS },
+   { SUB_ECU_410,               32,  8, 0,                      100./255.,   0.,     T_FLOAT,  ACCEL },
+   { SUB_ECU_410,               40, 16, 0,                      1.,          0.,     T_INT,    RPM },
+   // 0x411 bytes 1-2 unknown, byte 5 cruise control speed
+   { SUB_ECU_411,               32,  8, 0,                      1.,          0.,     T_INT,    GEAR },
+   { SUB_ECU_411,               52,  1, 0,                      1.,          0.,     T_SWITCH, BREAK_SW },
+   // 0x501 byte 2 torque reduction, 3 torque allowed, 4 torque down
+   { SUB_VCDS_TORQ,             40,  8, SIG_COUNTER,            1.,          0.,     T_NONE,   0 },
+   { SUB_VCDS_STEERING_SENSOR,   0, 16, SIG_SIGNED,             1.,          0.,     T_INT,    STEER_ANGLE },
+   // 0x512 bytes 6-7 fcode
+   { SUB_VCDS_SPEED,            16, 16, SIG_SIGNED,             0.05625,     0.,     T_FLOAT,  SPEED },
+   { SUB_VCDS_SPEED,            40,  8, 0,                      1.,          0.,     T_AUX,    SPEED_CNT },
+   { SUB_VCDS_SPEED,            40,  8, SIG_COUNTER,            1.,          0.,     T_NONE,   0 },
+   { SUB_VCDS_SPEEDS,            0, 16, SIG_SIGNED,             0.05625,     0.,     T_FLOAT,  SPEED_F_L },
+   { SUB_VCDS_SPEEDS,           16, 16, SIG_SIGNED,             0.05625,     0.,     T_FLOAT,  SPEED_F_R },
+   { SUB_VCDS_SPEEDS,           32, 16, SIG_SIGNED,             0.05625,     0.,     T_FLOAT,  SPEED_R_L },
+   { SUB_VCDS_SPEEDS,           48, 16, SIG_SIGNED,             0.05625,     0.,     T_FLOAT,  SPEED_R_R },
+   // 0x514 byte 4 left lever, byte 5 fuel level
+   { SUB_BIU_TEMP,              16, 16, SIG_SIGNED,             0.5,       -40.,     T_AUX,    AMB_TEMP },
+   { SUB_BIU_TEMP,              48,  8, 0,                      1.,          0.,     T_AUX,    TEMP_CNT },
+   { SUB_BIU_TEMP,              49,  3, SIG_COUNTER,            1.,          0.,     T_NONE,   0 },
+   // 0x600 byte 0 DPF bits
+   { SUB_ECU_600,                8, 16, 0,                      1.,          0.,     T_INT,    FUEL },
+   { SUB_ECU_600,               24,  8, 0,                      1.,        -40.,     T_AUX,    COOLANT },
+   { SUB_ECU_600,               32,  8, 0,                      1.,          0.,     T_AUX,    FUEL_CNT },
+   { SUB_ECU_600,               32,  8, SIG_COUNTER,            1.,          0.,     T_NONE,   0 },
+   { SUB_ECU_600,               50,  1, 0,                      1.,          0.,     T_SWITCH, CLUTCH_SW },
+   // 0x620 byte 2 bit 1 might be a door, too
+   { SUB_BIU_620,                5,  1, 0,                      1.,          0.,     T_SWITCH, DOOR_SW },
+};
+
+// frames we know, with whatever needs doing once their signals are decoded
+struct frame_def {
+   uint16_t id;
+   void (*post)(struct bus *);
+};
+
+static const struct frame_def builtin_frames[] = {
+   { SUB_STEERING_SENSOR,      NULL },
+   { SUB_VCDS_Y,               NULL },
+   { SUB_VCDS_X,               NULL },
+   { SUB_ECU_410,              NULL },
+   { SUB_ECU_411,              NULL },
+   { SUB_VCDS_TORQ,            NULL },
+   { SUB_VCDS_STEERING_SENSOR, NULL },
+   { SUB_VCDS_SPEED,           NULL },
+   { SUB_VCDS_SPEEDS,          post_vcds_speeds },
+   { SUB_BIU_TEMP,             NULL },
+   { SUB_ECU_600,              post_ecu_600 },
+   { SUB_BIU_620,              NULL },
+};
+
+// compiled form of the tables above, signals of a frame are adjacent
+struct sig_plan {
+   uint64_t mask;
+   double scale;
+   double offset;
+   uint8_t shift;
+   uint8_t len;
+   uint8_t flags;
+   uint8_t target;
+   uint8_t slot;
+};
+struct frame_plan {
+   uint16_t id;
+   uint16_t first;  // index into decode_sigs
+   uint16_t count;
+   uint8_t cnt_shift;  // rolling counter, if cnt_mask is set
+   uint8_t cnt_flags;
+   uint64_t cnt_mask;
+   uint8_t cacheable;  // no other frame writes its slots, see plan_cache()
+   void (*post)(struct bus *);
+};
+#define MAX_SIGNALS 4096
+static struct sig_plan decode_sigs[MAX_SIGNALS];
+static struct frame_plan decode_frames[CAN_SFF_MASK + 1];
+static int decode_nsigs, decode_nframes;
+// ID -> index into decode_frames + 1, 0 for frames we do not know
+static uint16_t decode_index[CAN_SFF_MASK + 1];
+
+#ifdef PROF
+// hot path instrumentation (make PROF=1): log2 histograms of how long each
+// stage takes, and for live buses how old a frame is by the time it is
+// output; dumped on SIGUSR1 and at the end of a session
+enum prof_stages {
+   PROF_RECV,        // recvmmsg() per frame, one sample per batch, ticks
+   PROF_QUEUE,       // kernel timestamp to decoding, us
+   PROF_OUTPUT,      // dump line or recording, ticks
+   PROF_DUMP,        // kernel timestamp to dump line written, us
+   PROF_RENDER,      // kernel timestamp to screen refreshed, us
+   PROF_STAGES
+};
+static const char *prof_names[PROF_STAGES] = {
+   "receive", "queued", "output", "to dump", "to screen",
+};
+static const char *prof_units[PROF_STAGES] = {
+   "ticks", "us", "ticks", "us", "us",
+};
+#define PROF_BUCKETS 32
+struct prof_hist {
+   uint64_t n, sum;
+   uint32_t hist[PROF_BUCKETS];
+};
+// each has a single writer, the thread of its stage
+static struct prof_hist prof[PROF_STAGES];
+static int prof_live;      // frame stamps are recent, latencies mean something
+static volatile sig_atomic_t prof_dump;
+
+// cycles where there is a cheap counter, else ns
+static inline uint64_t prof_now(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+   return __builtin_ia32_rdtsc();
+#else
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
 #endif
 }
 
-// process single CAN frame
-static void process_one(struct can_frame *frm)
+static inline void prof_add(struct prof_hist *h, uint64_t v)
 {
-        int i;
-	union u_frames *msg;
-
-	msg = (union u_frames *)frm->data;
+   int b = v ? 63 - __builtin_clzll(v) : 0;
 
-	switch (frm->can_id) {
-        case SUB_STEERING_SENSOR:
-	   int_mem[STEER_VAL] = (int32_t) msg->steering_sensor.angle;
-#ifdef NCURS
-		mvprintw(STEER_LINE, STEER_COL, "%7d",
-		      int_mem[STEER_VAL]);
-#endif
-		//refresh();
-		break;
-        case SUB_VCDS_Y:
-		float_mem[A_Y] = (float) msg->vcds_y.y_accel*0.00012742 - 4.1768;
-#ifdef NCURS
-		mvprintw(ACCEL_LINE, RPM_COL, "yaw rate  %7.3f deg/s     y_accel %7.3f g",
-		      (msg->vcds_y.yaw_rate*0.005 - 163.84),
-		      float_mem[A_Y]);
-                // hypothesis
-		mvprintw(ACCEL_LINE, col-13, "%5d",
-		      ( msg->vcds_y.byte6));
-		      //((int32_t) msg->vcds_y.counter));
-		mvprintw(ACCEL_LINE, col-5, "%5d",
-		      ( msg->vcds_y.byte7));
-
-		if (float_mem[A_Y] < minay)
-		   minay = float_mem[A_Y];
-		if (float_mem[A_Y] > maxay)
-		   maxay = float_mem[A_Y];
-		mvprintw(MINMAX_LINE+1, RPM_COL+21, "rig %7.4f y_accel",
-		                maxay);
-		mvprintw(MINMAX_LINE, RPM_COL+21, "lef %7.4f y_accel",
-		                minay);
-#endif
-		break;
-        case SUB_VCDS_X:
-		float_mem[A_X] = (float) msg->vcds_x.x_accel*0.00012742 - 4.1768;
-#ifdef NCURS
-		mvprintw(ACCEL_LINE+1, RPM_COL, "yaw accel %7.3f deg/s^2   x_accel %7.3f g",
-		      (msg->vcds_x.yaw_accel*0.125 - 4096),
-		      float_mem[A_X]);
-		mvprintw(ACCEL_LINE+1, col-13, "%5d",
-		      ( msg->vcds_x.byte6));
-		      //((int32_t) msg->vcds_x.counter));
-		mvprintw(ACCEL_LINE+1, col-5, "%5d",
-		      ( msg->vcds_x.byte7));
-
-		if (float_mem[A_X] < minax)
-		   minax = float_mem[A_X];
-		if (float_mem[A_X] > maxax)
-		   maxax = float_mem[A_X];
-		mvprintw(MINMAX_LINE+1, RPM_COL+45, "dec %7.4f x_accel",
-		                maxax);
-		mvprintw(MINMAX_LINE, RPM_COL+45, "acc %7.4f x_accel",
-		                minax);
-#endif
-		break;
-	case SUB_ECU_410:
-		int_mem[RPM] = (int32_t) msg->ecu_410.rpm;
-		float_mem[ACCEL] = (float) msg->ecu_410.accel*100./255.;
-		float_mem[TRANS_TORQ] = (float) msg->ecu_410.transtorq * 1.6;
-		float_mem[ENGINE_TORQ] = (float) msg->ecu_410.engtorq * 1.6;
-		float_mem[TORQ_LOSS] = (float) msg->ecu_410.torqloss * 1.6;
-#ifdef NCURS
-		mvprintw(ENGINE_LINE, RPM_COL, "%5d rpm",
-		      int_mem[RPM]);
-		mvprintw(ENGINE_LINE, ACCEL_COL, "%6.2f %",
-		      float_mem[ACCEL]);
-		mvprintw(TORQUE_LINE+1, RPM_COL, "%5.1f Nm %5.1f Nm %5.1f Nm   %5.1f",
-		      msg->ecu_410.transtorq * 1.6,
-		      msg->ecu_410.engtorq * 1.6,
-		      msg->ecu_410.torqloss * 1.6,
-		      (msg->ecu_410.transtorq-msg->ecu_410.engtorq) * 1.6);
-#endif
-	        break;
-	case SUB_ECU_411:
-		int_mem[GEAR] = (int32_t)msg->ecu_411.gear;
-#ifdef NCURS
-		mvprintw(AVG_SPEED_LINE, MID_WHL, "gear: %1d",
-		      int_mem[GEAR]);
-#endif
-		if(rbi(msg->ecu_411.byte6,4) ^ switches[BREAK_SW])
-		{
-		   switches[BREAK_SW] ^= 1;
-#ifdef NCURS
-		   if (switches[BREAK_SW])
-		   {
-		      attron(A_BOLD | COLOR_PAIR(WARN));
-		      mvprintw(row+SWITCHES_LINE, 3, "! BREAK !");
-		      attroff(A_BOLD | COLOR_PAIR(WARN));
-		   }
-		   else
-		      mvprintw(row+SWITCHES_LINE, 3, "         ");
-#endif
-		}
-	        break;
-	case SUB_VCDS_TORQ:
-	        break;
-        case SUB_VCDS_STEERING_SENSOR:
-		int_mem[STEER_ANGLE] = (int32_t) msg->vcds_steering_sensor.angle;
-#ifdef NCURS
-		mvprintw(STEER_LINE+1, STEER_COL, "%7d DEG",
-		      int_mem[STEER_ANGLE]);
-#endif
-		break;
-        case SUB_VCDS_SPEED:
-		float_mem[SPEED] = (float) msg->vcds_speed.speed * 0.05625;
-#ifdef NCURS
-		mvprintw(AVG_SPEED_LINE, LEFT_WHL, "%5.2f km/h",
-		      float_mem[SPEED]);
-		mvprintw(AVG_SPEED_LINE, col-5, "%5d",
-		      (msg->vcds_speed.counter));
+   h->hist[b < PROF_BUCKETS ? b : PROF_BUCKETS - 1]++;
+   h->sum += v;
+   h->n++;
+}
 #endif
-		break;
-        case SUB_VCDS_SPEEDS:
-		float_mem[SPEED_F_L] = (float) msg->vcds_speeds.frle * 0.05625;
-		float_mem[SPEED_F_R] = (float) msg->vcds_speeds.frri * 0.05625;
-		float_mem[SPEED_R_L] = (float) msg->vcds_speeds.rele * 0.05625;
-		float_mem[SPEED_R_R] = (float) msg->vcds_speeds.reri * 0.05625;
-#ifdef NCURS
-		mvprintw(IND_SPEED_LINE, LEFT_WHL, "%5.2f km/h",
-		                float_mem[SPEED_F_L]);
-		mvprintw(IND_SPEED_LINE, RIGHT_WHL, "%5.2f km/h",
-		                float_mem[SPEED_F_R]);
-		mvprintw(IND_SPEED_LINE, MID_WHL, "%5.2f",
-		                ((float_mem[SPEED_F_R]-float_mem[SPEED_F_L]) * 0.05625));
-		mvprintw(IND_SPEED_LINE+1, LEFT_WHL, "%5.2f",
-		                ((float_mem[SPEED_F_L]-float_mem[SPEED_R_L]) * 0.05625));
-		mvprintw(IND_SPEED_LINE+1, RIGHT_WHL, "%5.2f",
-		                ((float_mem[SPEED_F_R]-float_mem[SPEED_R_R]) * 0.05625));
-		mvprintw(IND_SPEED_LINE+2, LEFT_WHL, "%5.2f km/h",
-		                float_mem[SPEED_R_L]);
-		mvprintw(IND_SPEED_LINE+2, RIGHT_WHL, "%5.2f km/h",
-		                float_mem[SPEED_R_R]);
-		mvprintw(IND_SPEED_LINE+2, MID_WHL, "%5.2f",
-		                ((float_mem[SPEED_R_R]-float_mem[SPEED_R_L]) * 0.05625));
-
-		// now check tire preassures
-		tpms_check(tpms_flag);
 
+// timing of the known frames, same index as decode_frames
+// inter-arrival times go into log2 buckets, bucket b holds [2^b, 2^(b+1)) us
+#define HIST_BUCKETS 24
+struct frame_stats {
+   uint64_t count;
+   uint64_t first_us;
+   uint64_t last_us;
+   uint64_t min_dt;
+   uint64_t max_dt;
+   uint64_t sum_dt;
+   double sum_dt2;      // for the jitter
+   uint64_t cnt_first;  // first and last rolling counter value
+   uint64_t cnt_last;
+   uint32_t cnt_lost;   // frames missing according to the counter
+   uint32_t cnt_gaps;   // times the counter skipped
+   uint32_t cnt_dups;   // times the counter repeated
+   uint32_t hist[HIST_BUCKETS];
+   uint64_t last_le;    // payload of the last frame, valid once cached is set
+   uint8_t last_dlc;
+   uint8_t cached;
+   uint64_t unchanged;  // frames with the same payload as the one before
+#ifdef PROF
+   struct prof_hist decode;   // time to decode, in prof_now() ticks
 #endif
-		break;
-        case SUB_BIU_TEMP:
-#ifdef NCURS
-		mvprintw(TEMP_LINE, RPM_COL, "%5.1f degC",
-		                (msg->biu_temp.temp/2. - 40));
-		mvprintw(TEMP_LINE, col-5, "%5d",
-		                (msg->biu_temp.counter));
-#endif
-		break;
-	case SUB_ECU_600:
-		int_mem[FUEL] = (int32_t) msg->ecu_600.fuel;
-
-		if (msg->ecu_600.fuel/FUELFUDGE < minf)
-		   minf = msg->ecu_600.fuel/FUELFUDGE;
-		if (msg->ecu_600.fuel/FUELFUDGE > maxf)
-		   maxf = msg->ecu_600.fuel/FUELFUDGE;
-
-		// compute l/h
-		float lphr;
-		// each rev sees two injections
-		lphr = 2 * int_mem[FUEL]; // mm^3
-		// each minute has rpm revs
-		lphr *= int_mem[RPM];
-		// now include mm^3 -> l factor and 60mins
-		lphr *= 1.e-6;
-		lphr *= 60;
-		// add fudge factor...
-		lphr /= FUELFUDGE;
-		// compute l/1ookm
-		float lph;
-		// start w/ liters per hour
-		lph = lphr;
-		// normalise km/h to achieve 100km
-		lph /= float_mem[SPEED_F_L];
-		lph *= 100;
-
-		if(rbi(msg->ecu_600.clutch_bits,2) ^ switches[CLUTCH_SW])
-		{
-		   switches[CLUTCH_SW] ^= 1;
-#ifdef NCURS
-		   if (switches[CLUTCH_SW])
-		      mvprintw(row+SWITCHES_LINE, 13, "CLUTCH");
-		   else
-		      mvprintw(row+SWITCHES_LINE, 13, "      ");
-#endif
-		}
-#ifdef NCURS
-		mvprintw(FUEL_LINE, RPM_COL, "%5.2f mm3/s",
-		                (int_mem[FUEL]/FUELFUDGE));
-		mvprintw(MINMAX_LINE+1, RPM_COL, "max %5.2f mm3/s",
-		                maxf);
-		mvprintw(MINMAX_LINE, RPM_COL, "min %5.2f mm3/s",
-		                minf);
-		attron(COLOR_PAIR(HIL));
-		mvprintw(FUEL_LINE, RPM_COL+25, "%6.1f l/1oo km",
-		                lph);
-		mvprintw(FUEL_LINE, RPM_COL+12, "%6.1f l/h",
-		                lphr);
-		attroff(COLOR_PAIR(HIL));
-		mvprintw(TEMP_LINE, COOL_COL, "%5d degC",
-		                (msg->ecu_600.coolant)-40);
-		mvprintw(FUEL_LINE, col-5, "%5d",
-		                (msg->ecu_600.counter));
-#endif
-	        break;
-	case SUB_BIU_620:
-		if( (rbi(msg->biu_620.byte0,5) ^ switches[DOOR_SW]))// || (rbi(msg->biu_620.byte2,1) ^ switches.door_sw))
-		{
-		   switches[DOOR_SW] ^= 1;
-#ifdef NCURS
-		   if (switches[DOOR_SW])
-		   {
-		      attron(A_BOLD | COLOR_PAIR(WARN));
-		      mvprintw(row+SWITCHES_LINE, 23, " DOOR OPEN ");
-		      attroff(A_BOLD | COLOR_PAIR(WARN));
-		   }
-		   else
-		      mvprintw(row+SWITCHES_LINE, 23, "           ");
-#endif
-		}
-	        break;
-	default:
-		unknown_frame(frm->can_id);
-	}
+};
 
-	display += 1;
-	if (display%5 == 0)
-	{
-	   gettimeofday(&tv, NULL);
-#ifdef NCURS
-	   mvprintw(row - 1, 1, "values for file [%010ld.%06ld]:",tv.tv_sec, tv.tv_usec);
-	   for (i = 0; i < INT_COUNT; i++) {
-	      printw(" %5d", int_mem[i]);
-	   }
-	   for (i = 0; i < FLOAT_COUNT; i++) {
-	      printw(" %7.2f", float_mem[i]);
-	   }
-	   refresh();
-#else
-	   printf("%010ld.%06ld ",tv.tv_sec, tv.tv_usec);
-	   for (i = 0; i < INT_COUNT; i++) {
-	      printf(" %5d", int_mem[i]);
-	   }
-	   for (i = 0; i < FLOAT_COUNT; i++) {
-	      printf(" %7.2f", float_mem[i]);
-	   }
-	   for (i = 0; i < SWITCH_COUNT; i++) {
-	      printf(" %1d", switches[i]);
-	   }
-	   printf("\n");
+// binary recordings: a header, then fixed size records in host byte order
+// with all dump columns and a bitmap of the ones that changed since the
+// previous record, ints first, then floats, then switches
+#define REC_MAGIC "SCRB"
+#define REC_VERSION 1
+#define REC_BUF_SIZE (1 << 20)
+struct rec_header {
+   char magic[4];
+   uint16_t version;
+   uint16_t size;       // of a record
+   uint8_t ints;
+   uint8_t floats;
+   uint8_t switches;
+   uint8_t pad[5];
+};
+struct rec_record {
+   uint64_t stamp_us;
+   uint32_t changed;
+   uint32_t switches;   // bit per switch
+   int32_t ints[INT_COUNT];
+   float floats[FLOAT_COUNT];
+};
+
+// the recorder fills one buffer while a thread writes out the other
+struct recorder {
+   int fd;
+   char *buf[2];
+   size_t fill;         // of buf[cur]
+   int cur;
+   int pending;         // buffer handed to the writer, -1 if none
+   size_t pending_len;
+   int stop, error;
+   unsigned long records, stalls;
+   struct rec_record last;
+   pthread_t tid;
+   pthread_mutex_t lock;
+   pthread_cond_t cond;
+};
+
+// everything we know about one bus, each has its own decoder state
+#define MAX_BUSES 8
+struct bus {
+   char name[IFNAMSIZ];
+   int sock;               // -1 when decoding a log
+   int sample_sock;        // known-only sampling socket, -1 if none
+   // decoded values
+   int32_t int_mem[INT_COUNT];
+   float float_mem[FLOAT_COUNT];
+   float aux_mem[AUX_COUNT];
+   bool switches[SWITCH_COUNT];
+   uint32_t int_known, float_known; // slots decoded so far, one bit each
+   struct tpms {
+      float ratio[4];      // averaged speed of each wheel relative to the mean
+      float suspect[4];    // judged driving time the wheel looked low (s)
+      uint8_t low[4];      // what we think, warnings go by this
+      uint64_t last_us;
+      double judged;       // driving time we could judge (s)
+      unsigned int events;
+      // analysis workers only collect the samples that pass the gates, the
+      // estimator runs over all of them in order at the end
+      int collect;
+      struct tpms_sample *samples;
+      size_t nsamples, maxsamples;
+   } tpms;
+   // switch changes, counted from the first time a switch is decoded
+   uint32_t switch_seen;
+   bool switch_first[SWITCH_COUNT];
+   uint32_t switch_toggles[SWITCH_COUNT];
+   int display;            // this controlls how often we output data
+   // what changed since the last repaint, one bit per slot
+   // set by the decoder, taken and cleared by the renderer
+   uint32_t int_dirty, float_dirty, aux_dirty, switch_dirty, misc_dirty;
+   uint32_t extrema_dirty; // all time min or max of an agg slot changed
+   uint64_t last_frame_us; // timestamp of the latest decoded frame
+   unsigned long frames;
+   struct agg agg[AGG_SLOTS];
+   // trip computer, rates and times of the last samples
+   struct trip trip[TRIP_COUNT];
+   uint64_t fuel_us, dist_us;
+   float fuel_lph, speed_kmh;
+   // first samples, to join analysis chunks
+   uint64_t fuel_first_us, dist_first_us;
+   float fuel_first_lph, dist_first_kmh;
+   bool fuel_first_engine;
+   int trip_reset;         // set to have the decoder reset TRIP_A
+   // timing of the known frames, same index as decode_frames
+   struct frame_stats *stats;
+   // unknown frames, IDs in order of appearance in unknown_seen, so we
+   // never have to walk the tables
+   struct unknown_id unknown_std[CAN_SFF_MASK + 1];
+   struct unknown_id unknown_ext[UNKNOWN_EXT_COUNT];
+   struct unknown_id *unknown_seen[UNKNOWN_COUNT];
+   int unknown_n;
+   unsigned long unknown_ext_lost; // extended IDs that did not fit
+   struct recorder *rec;   // NULL if we do not record
+   uint32_t kernel_drops;  // SO_RXQ_OVFL, frames the socket queue lost
+   struct scooby_shm *shm; // NULL if we do not publish
+   int quiet;              // no dump output, for analysis workers and seeks
+#ifdef PROF
+   uint64_t prof_render_us; // oldest frame the screen has not shown, 0 if none
 #endif
-	   display = 0;
-	}
+};
+static struct bus *buses[MAX_BUSES];
+static int nbuses;
+static int any_iface;      // a log goes into buses[0], whatever the interface
 
-}
+struct timeval tv;
 
-// init ncurses
-static int ncurses_init(void)
-{
-   // init ncurses
-   initscr();
-   //pass C- on, keep the rest
-   cbreak(); //raw();
-   // do sth to F-keys
-   keypad(stdscr, TRUE);
-   // turn of echoing to screen
-   noecho();
+static volatile sig_atomic_t running = 1; // cleared by SIGINT/SIGTERM
 
-   if(has_colors() == FALSE)
-   {
-      endwin();
-      printf("Your terminal does not support colour -- we want colour...\n");
-      return 1;
-   }
-   // enable colour
-   start_color();
-   init_pair(HEADING, COLOR_BLACK, COLOR_CYAN);
-   init_pair(WARN, COLOR_RED, COLOR_BLACK);
-   init_pair(HIL, COLOR_GREEN, COLOR_BLACK);
+// the render thread and its rate
+static pthread_t render_tid;
+static volatile int rendering;
+static int shown;          // the bus on screen
+static int render_hz = RENDER_HZ_DEFAULT;
 
-   // get screen dimensions
-   getmaxyx(stdscr,row,col);
-   if (row < LINES || col < WIDTH)
-   {
-      endwin();
-      printf("Sorry, your terminal is too small to fit all data.\nCurrent size is %2dx%2d\nMinimum size is %2dx%2d\n",row,col,LINES,WIDTH);
-      return 1;
-   }
+// receive buffers for recvmmsg(), one frame and one timestamp per slot
+static int recv_batch = RECV_BATCH_DEFAULT;
+static struct can_frame recv_frames[RECV_BATCH_MAX];
+static struct timeval recv_stamps[RECV_BATCH_MAX];
+static struct iovec recv_iov[RECV_BATCH_MAX];
+static struct mmsghdr recv_msgs[RECV_BATCH_MAX];
+static char recv_cmsg[RECV_BATCH_MAX][CMSG_SPACE(sizeof(struct timeval)) +
+   CMSG_SPACE(sizeof(uint32_t))];
+// receive statistics, reported on exit
+static unsigned long recv_calls, recv_count, recv_nostamp, recv_sampled;
 
-   // paint initial screen w/o values
-   paint_empty_scr();
+// live frames go from the receiver thread to the decoder through a single
+// producer, single consumer ring, so a slow decoder does not make the
+// kernel drop frames
+struct ring_slot {
+   struct can_frame frm;
+   struct timeval stamp;
+   struct bus *b;
+   int sampled;            // from the known-only sampling socket
+};
+static struct {
+   // written by the receiver only
+   uint32_t head __attribute__((aligned(64)));
+   uint32_t high_water;
+   unsigned long full;     // frames dropped because the decoder fell behind
+   // written by the decoder only
+   uint32_t tail __attribute__((aligned(64)));
+   // futex, set while the decoder sleeps on an empty ring
+   int waiting __attribute__((aligned(64)));
+   struct ring_slot slot[RING_SIZE];
+} ring;
+static pthread_t receive_tid;
+static int receive_stop_fd = -1;
 
-   return 0;
+// playing a log onto the buses we receive from, NULL unless we do
+struct player;
+static struct player *player;
+
+// dump the mean over this window instead of the latest values, -1 for none
+static int dump_window = -1;
+
+// dump lines are formatted into a buffer of our own and written out when
+// it fills up or whenever we are about to wait, see dump_flush()
+enum dump_formats {
+   DUMP_COLUMNS,
+   DUMP_CSV,
+   DUMP_TSV,
+   DUMP_FORMATS
+};
+static const char *dump_format_names[DUMP_FORMATS] = { "columns", "csv", "tsv" };
+#define DUMP_BUF_SIZE (1 << 20)
+#define DUMP_LINE_MAX 1024   // more than any line takes
+static struct {
+   int format;
+   int header;     // CSV and TSV start with the column names
+   size_t len;
+   char buf[DUMP_BUF_SIZE];
+} dump;
+
+// where the decoded values go: the screen, dump lines, a binary recording
+// or nowhere at all, picked once at startup so the decoder only ever
+// calls through the table
+struct sink {
+   const char *name;
+   int screen;                  // the terminal is ours
+   int (*open)(int bench);      // 0 if we are good to go
+   void (*start)(void);         // decoding starts
+   // decoding is over, why is shown until a key is pressed if not NULL
+   void (*stop)(const char *why);
+   // every few frames of a bus, the values as they are now
+   void (*line)(struct bus *b, uint64_t now, const struct timeval *stamp);
+   // the TPMS guess for a wheel changed
+   void (*tpms)(struct bus *b, uint64_t now, int wheel);
+};
+enum sinks {
+   SINK_TUI,
+   SINK_DUMP,
+   SINK_RECORD,
+   SINK_NULL,
+   SINKS
+};
+static const struct sink sinks[SINKS];
+static const struct sink *sink = &sinks[SINK_NULL];
+// the sink's line, or that of a recording, or of a dump of the means
+static void (*sink_line)(struct bus *b, uint64_t now, const struct timeval *stamp);
+
+// known-only mode, the kernel filters what we do not decode and unknown
+// IDs are picked up from a sampling socket per bus
+static int known_only;
+
+// analyse the payloads of unknown IDs
+static int unknown_rev;
+
+// decode every frame even if its payload is the same as last time
+static int decode_full;
+
+// functions start here
+//
+// frame timestamp in microseconds
+static inline uint64_t stamp_us(const struct timeval *stamp)
+{
+   return (uint64_t) stamp->tv_sec * 1000000 + stamp->tv_usec;
 }
 
-// init ncurses screen and fill in some text
-static int paint_empty_scr(void)
+#ifdef PROF
+// how old a frame stamped us is now
+static inline uint64_t prof_age_us(uint64_t us)
 {
-   int i = 1;
-   for(i=1; i<=row; i++)
-   {
-      move(i, 1);
-      clrtoeol();
-   }
-   //attron(A_BOLD | A_REVERSE | COLOR_PAIR(2));
-   mvprintw(0, 0, " SCOOBY-DOO CAN VIEWER                                ");
-   //attroff(A_BOLD | A_REVERSE | COLOR_PAIR(2));
-   mvchgat(0, 0, -1, A_BOLD, 1, NULL);
-   mvprintw(STEER_LINE, 1, "steering value:");
-   mvprintw(STEER_LINE+1, 1, "steering angle degrees (LEFT -angle..angle RIGHT):");
-   mvprintw(AVG_SPEED_LINE, 1, "avg front wheel speed:");
-   mvprintw(AVG_SPEED_LINE, col-5-7, "msg cnt");
-   mvprintw(IND_SPEED_LINE, 1, "front wheel speeds:");
-   mvprintw(IND_SPEED_LINE+2, 1, "rear wheel speeds:");
-   mvprintw(TEMP_LINE, 1, "ambient temperature:      degC");
-   mvprintw(TEMP_LINE, col-5-7, "msg cnt");
-   mvprintw(FUEL_LINE, 1, "fuel consumption:");
-   mvprintw(TEMP_LINE, COOL_COL-20, "coolant temperature:");
-   mvprintw(FUEL_LINE, col-5-7, "msg cnt");
-   mvprintw(ENGINE_LINE, 1, "engine:");
-   mvprintw(ENGINE_LINE, ACCEL_COL-11, "accel ped:");
-   mvprintw(TORQUE_LINE, 1, "torques:");
-   mvprintw(TORQUE_LINE, RPM_COL, "  transm   engine     loss");
-   mvprintw(ACCEL_LINE, 1, "acceleration data:");
-   mvprintw(MINMAX_LINE, 1, "extrema:");
+   struct timeval now;
 
-   refresh;
-   return 0;
+   gettimeofday(&now, NULL);
+   return stamp_us(&now) > us ? stamp_us(&now) - us : 0;
 }
+#endif
 
-// TPMS - tire pressure monitoring system :-)
-static int tpms_check(int *tpms_flag)
-{
-   enum pos {
-      FRONT_WHLS,
-      REAR_WHLS,
-      LEFT_WHLS,
-      RIGHT_WHLS,
-      POS_COUNT
-   };
-   float diff[POS_COUNT], avg[POS_COUNT], rel[POS_COUNT];
-   int angle = int_mem[STEER_ANGLE]*int_mem[STEER_ANGLE];
+// the table entry of an unknown ID, new IDs are added with a count of 0
+// returns NULL if there is no room
+static struct unknown_id *unknown_entry(struct bus *b, canid_t id, uint64_t now)
+{
+   struct unknown_id *u;
+   uint32_t h;
+   int i;
 
-   // are we cornering, if so ignore TPMS guess?
-   if (angle > TPMS_STEER_LIMIT*TPMS_STEER_LIMIT)
-      return 0;
+   if (id & CAN_EFF_FLAG) {
+      // multiplicative hash, linear probing
+      h = ((id & CAN_EFF_MASK) * 2654435761u) >> (32 - UNKNOWN_EXT_BITS);
+      for (i = 0; i < UNKNOWN_EXT_COUNT; i++) {
+	 u = &b->unknown_ext[(h + i) & (UNKNOWN_EXT_COUNT - 1)];
+	 if (u->id == id || u->id == 0)
+	    break;
+      }
+      if (i == UNKNOWN_EXT_COUNT)
+	 return NULL;
+   } else
+      u = &b->unknown_std[id & CAN_SFF_MASK];
 
-   // start by checking all wheel speeds against each other
-   diff[FRONT_WHLS] = float_mem[SPEED_F_L] - float_mem[SPEED_F_R];
-   diff[REAR_WHLS]  = float_mem[SPEED_R_L] - float_mem[SPEED_R_R];
-   diff[LEFT_WHLS]  = float_mem[SPEED_F_L] - float_mem[SPEED_R_L];
-   diff[RIGHT_WHLS] = float_mem[SPEED_F_R] - float_mem[SPEED_R_R];
-   // look at average speeds for rel difference 
-   avg[FRONT_WHLS] = (float_mem[SPEED_F_L] + float_mem[SPEED_F_R])/2.;
-   avg[REAR_WHLS]  = (float_mem[SPEED_R_L] + float_mem[SPEED_R_R])/2.;
-   avg[LEFT_WHLS]  = (float_mem[SPEED_F_L] + float_mem[SPEED_R_L])/2.;
-   avg[RIGHT_WHLS] = (float_mem[SPEED_F_R] + float_mem[SPEED_R_R])/2.;
-   // relative differences
-   rel[FRONT_WHLS] = diff[FRONT_WHLS] / avg[FRONT_WHLS];
-   rel[REAR_WHLS]  = diff[REAR_WHLS]  / avg[REAR_WHLS];
-   rel[LEFT_WHLS]  = diff[LEFT_WHLS]  / avg[LEFT_WHLS];
-   rel[RIGHT_WHLS] = diff[RIGHT_WHLS] / avg[RIGHT_WHLS];
-
-   // clear text - in case there is one
-   mvprintw(row+SWITCHES_LINE-4, 10, "                                    %5d ",tpms_flag[0]);
-   mvprintw(row+SWITCHES_LINE-3, 10, "                                    %5d ",tpms_flag[1]);
-   mvprintw(row+SWITCHES_LINE-2, 10, "                                    %5d ",tpms_flag[2]);
-   mvprintw(row+SWITCHES_LINE-1, 10, "                                    %5d ",tpms_flag[3]);
-
-   // identify fast one (this requires two above limit)
-   // front left
-   if ( rel[FRONT_WHLS] > 0.02 && rel[LEFT_WHLS] > 0.02 ) 
-      tpms_flag[0]+=1; // it's faster
-   else
-      if (tpms_flag[0] < TPMS_COUNT_LIMIT)  // we still think everything is ok, so reduce warn level
-	 tpms_flag[0]-=1;
-      else
-	 if (tpms_flag[0] < 10*TPMS_COUNT_LIMIT)  // we have issued warning, so stay alert for longer
-	    tpms_flag[0]-=1;
-   if (tpms_flag[0] > TPMS_COUNT_LIMIT)
-   {
-      attron(A_BOLD | COLOR_PAIR(WARN) | A_REVERSE);
-      mvprintw(row+SWITCHES_LINE-4, 10, "CHECK PREASSURE OF FRONT LEFT WHEEL!");
-      attroff(A_BOLD | COLOR_PAIR(WARN) | A_REVERSE);
+   if (u->count == 0) {
+      u->id = id;
+      u->first_us = now;
+      b->unknown_seen[b->unknown_n] = u;
+      // the renderer may be looking, publish the entry before the count
+      __atomic_store_n(&b->unknown_n, b->unknown_n + 1, __ATOMIC_RELEASE);
    }
-   if (tpms_flag[0] < 0)
-      tpms_flag[0] = 0;
+   return u;
+}
 
-   // front right
-   if ( rel[FRONT_WHLS] < -0.02 && rel[RIGHT_WHLS] > 0.02 ) 
-      tpms_flag[1]+=1; // it's faster
-   else
-      if (tpms_flag[1] < TPMS_COUNT_LIMIT)  // we still think everything is ok, so reduce warn level
-	 tpms_flag[1]-=1;
-      else
-	 if (tpms_flag[1] < 10*TPMS_COUNT_LIMIT)  // we have issued warning, so stay alert for longer
-	    tpms_flag[1]-=1;
-   if (tpms_flag[1] > TPMS_COUNT_LIMIT)
-   {
-      attron(A_BOLD | COLOR_PAIR(WARN) | A_REVERSE);
-      mvprintw(row+SWITCHES_LINE-3, 10, "CHECK PREASSURE OF FRONT RIGHT WHEEL!");
-      attroff(A_BOLD | COLOR_PAIR(WARN) | A_REVERSE);
-   }
-   if (tpms_flag[1] < 0)
-      tpms_flag[1] = 0;
+// count the set bits of w in the bit-sliced counters planes
+static inline void rev_count(uint64_t *planes, uint64_t w)
+{
+   uint64_t carry;
+   int k;
 
-   // rear left
-   if ( rel[REAR_WHLS] > 0.02 && rel[LEFT_WHLS] < -0.02 ) 
-      tpms_flag[2]+=1; // it's faster
-   else
-      if (tpms_flag[2] < TPMS_COUNT_LIMIT)  // we still think everything is ok, so reduce warn level
-	 tpms_flag[2]-=1;
-      else
-	 if (tpms_flag[2] < 10*TPMS_COUNT_LIMIT)  // we have issued warning, so stay alert for longer
-	    tpms_flag[2]-=1;
-   if (tpms_flag[2] > TPMS_COUNT_LIMIT)
-   {
-      attron(A_BOLD | COLOR_PAIR(WARN) | A_REVERSE);
-      mvprintw(row+SWITCHES_LINE-2, 10, "CHECK PREASSURE OF REAR LEFT WHEEL!");
-      attroff(A_BOLD | COLOR_PAIR(WARN) | A_REVERSE);
+   for (k = 0; w && k < REV_PLANES; k++) {
+      carry = planes[k] & w;
+      planes[k] ^= w;
+      w = carry;
    }
-   if (tpms_flag[2] < 0)
-      tpms_flag[2] = 0;
+}
 
-   // rear right
-   if ( rel[REAR_WHLS] < -0.02 && rel[LEFT_WHLS] < -0.02 ) 
-      tpms_flag[3]+=1; // it's faster
-   else
-      if (tpms_flag[3] < TPMS_COUNT_LIMIT)  // we still think everything is ok, so reduce warn level
-	 tpms_flag[3]-=1;
-      else
-	 if (tpms_flag[3] < 10*TPMS_COUNT_LIMIT)  // we have issued warning, so stay alert for longer
-	    tpms_flag[3]-=1;
-   if (tpms_flag[3] > TPMS_COUNT_LIMIT)
-   {
-      attron(A_BOLD | COLOR_PAIR(WARN) | A_REVERSE);
-      mvprintw(row+SWITCHES_LINE-1, 10, "CHECK PREASSURE OF REAR RIGHT WHEEL!");
-      attroff(A_BOLD | COLOR_PAIR(WARN) | A_REVERSE);
-   }
-   if (tpms_flag[3] < 0)
-      tpms_flag[3] = 0;
+// add bit-sliced counters to plain ones
+static void rev_add(const uint64_t *planes, uint32_t *counts)
+{
+   uint64_t w;
+   int k;
 
-   return 0;
+   for (k = 0; k < REV_PLANES; k++)
+      for (w = planes[k]; w; w &= w - 1)
+	 counts[__builtin_ctzll(w)] += 1u << k;
 }
 
-// init our global data structures
-static int mem_init(void)
+static void rev_flush(struct unknown_rev *r)
 {
-   int i;
+   rev_add(r->toggle_planes, r->toggles);
+   rev_add(r->event_planes, r->events);
+   memset(r->toggle_planes, 0, sizeof(r->toggle_planes));
+   memset(r->event_planes, 0, sizeof(r->event_planes));
+   r->pending = 0;
+}
 
-   maxf = 0.0;
-   minf = 1000000.0;
-   maxax = 0.0;
-   minax = 1000000.0;
-   maxay = 0.0;
-   minay = 1000000.0;
-   display = 0;
-   tpms_flag[0] = 0;
-   tpms_flag[1] = 0;
-   tpms_flag[2] = 0;
-   tpms_flag[3] = 0;
+// 0x80 in each byte of x that is 0, exact unlike the usual haszero()
+static inline uint64_t zero_bytes(uint64_t x)
+{
+   const uint64_t low7 = 0x7f7f7f7f7f7f7f7full;
 
-   // init switches
-   switches[BREAK_SW] = 1;
-   switches[CLUTCH_SW] = 1;
-   switches[DOOR_SW] =1;
+   return ~(((x & low7) + low7) | x | low7);
+}
 
-   // init values
-   for (i = 0; i < INT_COUNT; i++) {
-      int_mem[i] = 0;
-   }
-   // init float values
-   for (i = 0; i < FLOAT_COUNT; i++) {
-      float_mem[i] = 0.0;
-   }
+// 0x8 in each nibble of x that is 0
+static inline uint64_t zero_nibbles(uint64_t x)
+{
+   const uint64_t low3 = 0x7777777777777777ull;
 
-   return 0;
+   return ~(((x & low3) + low3) | x | low3);
 }
 
-static int net_init(char *ifname)
+// which bytes and nibbles went up by one from prev to w
+static inline uint64_t rev_steps(uint64_t prev, uint64_t w)
 {
-   int recv_own_msgs;
-   struct sockaddr_can addr;
-   struct ifreq ifr;
+   const uint64_t h8 = 0x8080808080808080ull, h4 = 0x8888888888888888ull;
+   uint64_t d8, d4;
 
-   can_socket = socket(PF_CAN, SOCK_RAW, CAN_RAW);
-   if (can_socket < 0) {
-      perror("socket");
-      exit(1);
-   }
+   // w - prev in each byte and in each nibble, without borrows between them
+   d8 = ((w | h8) - (prev & ~h8)) ^ ((w ^ ~prev) & h8);
+   d4 = ((w | h4) - (prev & ~h4)) ^ ((w ^ ~prev) & h4);
+   return zero_nibbles(d4 ^ 0x1111111111111111ull) |
+      zero_bytes(d8 ^ 0x0101010101010101ull) >> (7 - REV_BYTE);
+}
 
-   memset(&ifr.ifr_name, 0, sizeof(ifr.ifr_name));
-   strncpy(ifr.ifr_name, ifname, IFNAMSIZ);
-   if (ioctl(can_socket, SIOCGIFINDEX, &ifr) < 0) {
-      perror("SIOCGIFINDEX");
-      exit(1);
-   }
+// the known signals we look for in unknown payloads, NAN if not decoded yet
+static inline double rev_ref(const struct bus *b, int i)
+{
+   if (i == 0)
+      return b->int_known & 1u << RPM ? b->int_mem[RPM] : NAN;
+   return b->float_known & 1u << SPEED ? b->float_mem[SPEED] : NAN;
+}
 
-   memset(&addr, 0, sizeof(addr));
-   addr.can_family = AF_CAN;
-   addr.can_ifindex = ifr.ifr_ifindex;
-   if (bind(can_socket, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
-      perror("bind");
-      return 1;
-   }
+static const char *rev_ref_name(int i)
+{
+   return i == 0 ? int_names[RPM] : float_names[SPEED];
+}
 
-   recv_own_msgs = 0; /* 0 = disabled (default), 1 = enabled */
-   setsockopt(can_socket, SOL_CAN_RAW, CAN_RAW_RECV_OWN_MSGS,
-	 &recv_own_msgs, sizeof(recv_own_msgs));
+// the candidate signals of a payload, bytes then little then big endian words
+static inline void rev_candidates(uint64_t w, double *x)
+{
+   int j;
 
-   return 0;
+   for (j = 0; j < CAN_MAX_DLEN; j++)
+      x[j] = (w >> 8 * j) & 0xff;
+   for (j = 0; j < CAN_MAX_DLEN - 1; j++) {
+      x[CAN_MAX_DLEN + j] = (w >> 8 * j) & 0xffff;
+      x[2 * CAN_MAX_DLEN - 1 + j] = ((w >> 8 * j) & 0xff) << 8 | ((w >> 8 * (j + 1)) & 0xff);
+   }
 }
 
-static void receive_one(void)
+// one more payload of an unknown ID, a word at a time where we can
+static void rev_frame(struct bus *b, struct unknown_rev *r, canid_t id,
+      const struct can_frame *frm)
 {
-   struct can_frame frm;
-   struct sockaddr_can addr;
-   int ret;
-   socklen_t len;
+   double x[REV_CANDIDATES], y;
+   uint64_t w, mask, lanes, dbl, sum, ev, fold;
+   uint32_t ids;
+   int j, k;
 
-   ret = recvfrom(can_socket, &frm, sizeof(struct can_frame), 0,
-	 (struct sockaddr *)&addr, &len);
-   if (ret < 0) {
-      perror("recvfrom");
-      exit(1);
+   mask = frm->can_dlc >= CAN_MAX_DLEN ? ~0ull : (1ull << 8 * frm->can_dlc) - 1;
+   memcpy(&w, frm->data, sizeof(w));
+   w = le64toh(w) & mask;
+   if (frm->can_dlc > r->dlc)
+      r->dlc = frm->can_dlc > CAN_MAX_DLEN ? CAN_MAX_DLEN : frm->can_dlc;
+   for (j = 0; j < r->dlc; j++)
+      r->values[j][(w >> (8 * j + 6)) & 3] |= 1ull << ((w >> 8 * j) & 63);
+
+   // sum of the bytes, pairwise in 16 bit lanes so nothing carries over
+   lanes = (w & 0x00ff00ff00ff00ffull) + ((w >> 8) & 0x00ff00ff00ff00ffull);
+   sum = (lanes * 0x0001000100010001ull) >> 48;
+   ids = (id & 0xff) + (id >> 8 & 0xff) + (id >> 16 & 0xff) + (id >> 24 & 0x1f);
+   // a checksum c of the other bytes has 2c == sum of all of them
+   dbl = (w & 0x7f7f7f7f7f7f7f7full) << 1;
+   ev = zero_bytes(dbl ^ ((sum & 0xff) * 0x0101010101010101ull)) >> (7 - REV_SUM);
+   ev |= zero_bytes(dbl ^ (((sum + ids) & 0xff) * 0x0101010101010101ull)) >> (7 - REV_SUM_ID);
+   fold = w ^ w >> 32;
+   fold ^= fold >> 16;
+   fold ^= fold >> 8;
+   r->xor_zero += (fold & 0xff) == 0;
+
+   if (r->frames) {
+      rev_count(r->toggle_planes, r->last ^ w);
+      ev |= rev_steps(r->last, w);
+   } else {
+      r->first = w;
+      r->first_dlc = frm->can_dlc;
    }
+   rev_count(r->event_planes, ev & mask);
+   r->last = w;
+   r->frames++;
+   if (++r->pending == REV_FLUSH)
+      rev_flush(r);
 
-   process_one(&frm);
+   rev_candidates(w, x);
+   for (k = 0; k < REV_REFS; k++) {
+      y = rev_ref(b, k);
+      if (isnan(y))
+	 continue;
+      r->n[k]++;
+      r->sy[k] += y;
+      r->syy[k] += y * y;
+      for (j = 0; j < REV_CANDIDATES; j++) {
+	 r->sx[k][j] += x[j];
+	 r->sxx[k][j] += x[j] * x[j];
+	 r->sxy[k][j] += x[j] * y;
+      }
+   }
 }
 
-int main(int argc, char **argv)
+// deal with unknown frames, constant time per frame
+static void unknown_frame(struct bus *b, struct can_frame *frm, uint64_t now)
 {
-   printf("known frame IDs: %d\n",FRAME_COUNT);
-   printf("monitored floats: %d\n",FLOAT_COUNT);
-   printf("monitored ints: %d\n\n\n",INT_COUNT);
-   gettimeofday(&tv, NULL);
-   printf("current timestamp [%010ld.%06ld]\n\n",tv.tv_sec, tv.tv_usec);
+   struct unknown_id *u;
 
-   if (argc != 2) {
-      printf("syntax: %s IFNAME\n", argv[0]);
-      exit(1);
+   u = unknown_entry(b, frm->can_id & (CAN_EFF_FLAG | CAN_EFF_MASK), now);
+   if (u == NULL) {
+      b->unknown_ext_lost++;
+      return;
+   }
+   u->count++;
+   u->last_us = now;
+   u->dlc = frm->can_dlc;
+   memcpy(u->data, frm->data, CAN_MAX_DLEN);
+   if (unknown_rev) {
+      // once per ID, an ID we have no memory for just goes without
+      if (u->rev == NULL)
+	 u->rev = calloc(1, sizeof(*u->rev));
+      if (u->rev != NULL)
+	 rev_frame(b, u->rev, u->id, frm);
    }
+}
 
-   memset(unknown, 0, sizeof(unknown));
+// arrival rate of an unknown ID in frames/s
+static double unknown_rate(const struct unknown_id *u)
+{
+   if (u->count < 2 || u->last_us == u->first_us)
+      return 0.;
+   return (u->count - 1) * 1.e6 / (u->last_us - u->first_us);
+}
 
-   mem_init();
+// busiest first
+static int unknown_cmp(const void *a, const void *b)
+{
+   const struct unknown_id *ua = *(struct unknown_id * const *)a;
+   const struct unknown_id *ub = *(struct unknown_id * const *)b;
 
-#ifdef NCURS
-   //ncurses_init();
-   if (!(ncurses_init() == 0))
-      return 1;
-#endif
+   if (ua->count != ub->count)
+      return ua->count < ub->count ? 1 : -1;
+   return ua->id < ub->id ? -1 : ua->id > ub->id;
+}
 
-   net_init(argv[1]);
+// sorted one line summary of unknown frames, refreshed periodically
+// by the renderer while the decoder keeps adding to the list
+static void unknown_summary(struct bus *b)
+{
+   static struct unknown_id *sorted[UNKNOWN_COUNT];
+   int i, n, y, x;
 
-   for (;;)
-      receive_one();
+   n = __atomic_load_n(&b->unknown_n, __ATOMIC_ACQUIRE);
+   memcpy(sorted, b->unknown_seen, n * sizeof(sorted[0]));
+   qsort(sorted, n, sizeof(sorted[0]), unknown_cmp);
 
-#ifdef NCURS
-   endwin();
-#endif
+   move(row - 3, 1);
+   clrtoeol();
+   mvprintw(row - 3, 1, "unknown frames (%d):", n);
+   for (i = 0; i < n; i++) {
+      getyx(stdscr, y, x);
+      if (y != row - 3 || x + 14 > col)
+	 break;
+      if (sorted[i]->id & CAN_EFF_FLAG)
+	 printw(" %08x %.0f/s", sorted[i]->id & CAN_EFF_MASK, unknown_rate(sorted[i]));
+      else
+	 printw(" %03x %.0f/s", sorted[i]->id, unknown_rate(sorted[i]));
+   }
+}
 
-   return 0;
+// share of n in total, 0 if there is nothing to share
+static double rev_share(uint32_t n, uint32_t total)
+{
+   return total ? (double) n / total : 0.;
+}
+
+// correlation of candidate j with reference k
+static double rev_r(const struct unknown_rev *r, int k, int j)
+{
+   double n = r->n[k], vx, vy;
+
+   vx = n * r->sxx[k][j] - r->sx[k][j] * r->sx[k][j];
+   vy = n * r->syy[k] - r->sy[k] * r->sy[k];
+   if (n < REV_MIN_FRAMES || vx <= 0. || vy <= 0.)
+      return 0.;
+   return (n * r->sxy[k][j] - r->sx[k][j] * r->sy[k]) / sqrt(vx * vy);
+}
+
+// what the payload analysis of an unknown ID found
+static void report_rev(struct unknown_rev *r, FILE *out)
+{
+   static const char *sums[] = { "the other bytes", "the other bytes and the ID" };
+   double share, best;
+   int j, k, i, values[CAN_MAX_DLEN], top;
+   uint32_t n;
+
+   rev_flush(r);
+   if (r->frames < 2 || r->dlc == 0)
+      return;
+   fprintf(out, "            byte    ");
+   for (j = 0; j < r->dlc; j++)
+      fprintf(out, " %8d", j);
+   fprintf(out, "\n            values  ");
+   for (j = 0; j < r->dlc; j++) {
+      values[j] = 0;
+      for (k = 0; k < 4; k++)
+	 values[j] += __builtin_popcountll(r->values[j][k]);
+      fprintf(out, " %8d", values[j]);
+   }
+   // tenths of the frames a bit changed in, msb first
+   fprintf(out, "\n            toggles  ");
+   for (j = 0; j < r->dlc; j++) {
+      for (k = 7; k >= 0; k--) {
+	 n = r->toggles[8 * j + k];
+	 share = rev_share(n, r->frames - 1);
+	 fputc(n == 0 ? '.' : share >= 0.9 ? '9' : '0' + (int) (share * 10), out);
+      }
+      fputc(' ', out);
+   }
+   fprintf(out, "\n");
+
+   if (r->frames < REV_MIN_FRAMES)
+      return;
+   for (j = 0; j < r->dlc; j++) {
+      if (values[j] < 4)
+	 continue;
+      share = rev_share(r->events[8 * j + REV_BYTE], r->frames - 1);
+      if (share >= REV_SHARE)
+	 fprintf(out, "            byte %d counts up by one (%.1f%%)\n", j, 100. * share);
+      else
+	 for (k = 0; k < 2; k++) {
+	    share = rev_share(r->events[8 * j + (k ? REV_NIBBLE_HI : REV_NIBBLE_LO)],
+		  r->frames - 1);
+	    if (share >= REV_SHARE)
+	       fprintf(out, "            byte %d %s nibble counts up by one (%.1f%%)\n",
+		     j, k ? "high" : "low", 100. * share);
+	 }
+      // a checksum takes all sorts of values
+      if (values[j] < 16)
+	 continue;
+      for (k = 0; k < 2; k++) {
+	 share = rev_share(r->events[8 * j + (k ? REV_SUM_ID : REV_SUM)], r->frames);
+	 if (share >= REV_SHARE) {
+	    fprintf(out, "            byte %d is a checksum, the sum of %s (%.1f%%)\n",
+		  j, sums[k], 100. * share);
+	    break;
+	 }
+      }
+   }
+   share = rev_share(r->xor_zero, r->frames);
+   for (j = 0, top = 0; j < r->dlc; j++)
+      if (values[j] > top)
+	 top = values[j];
+   if (share >= REV_SHARE && top >= 16)
+      fprintf(out, "            the bytes XOR to 0 (%.1f%%), one is an XOR checksum\n",
+	    100. * share);
+
+   // the best candidate for each known signal, if it is good enough
+   for (k = 0; k < REV_REFS; k++) {
+      for (j = 0, i = -1, best = 0.; j < REV_CANDIDATES; j++)
+	 if (fabs(rev_r(r, k, j)) > fabs(best)) {
+	    best = rev_r(r, k, j);
+	    i = j;
+	 }
+      if (i < 0 || fabs(best) < REV_MIN_R)
+	 continue;
+      if (i < CAN_MAX_DLEN)
+	 fprintf(out, "            byte %d", i);
+      else if (i < 2 * CAN_MAX_DLEN - 1)
+	 fprintf(out, "            bytes %d-%d little endian", i - CAN_MAX_DLEN,
+	       i - CAN_MAX_DLEN + 1);
+      else
+	 fprintf(out, "            bytes %d-%d big endian", i - 2 * CAN_MAX_DLEN + 1,
+	       i - 2 * CAN_MAX_DLEN + 2);
+      fprintf(out, " follows %s, r = %.3f\n", rev_ref_name(k), best);
+   }
+}
+
+// full table of unknown frames, for the end of a session
+static void report_unknown(struct bus *b, FILE *out)
+{
+   int i, j;
+   struct unknown_id *u;
+
+   qsort(b->unknown_seen, b->unknown_n, sizeof(b->unknown_seen[0]), unknown_cmp);
+
+   fprintf(out, "unknown frames: %d IDs\n", b->unknown_n);
+   for (i = 0; i < b->unknown_n; i++) {
+      u = b->unknown_seen[i];
+      if (u->id & CAN_EFF_FLAG)
+	 fprintf(out, "  %08x", u->id & CAN_EFF_MASK);
+      else
+	 fprintf(out, "  %03x     ", u->id);
+      fprintf(out, " %9u frames %8.2f/s  last", u->count, unknown_rate(u));
+      for (j = 0; j < u->dlc; j++)
+	 fprintf(out, " %02X", u->data[j]);
+      fprintf(out, "\n");
+      if (u->rev != NULL)
+	 report_rev(u->rev, out);
+   }
+   if (b->unknown_ext_lost)
+      fprintf(out, "  %lu extended frames did not fit the table\n", b->unknown_ext_lost);
+}
+
+// store decoded values, flagging the ones that changed for the renderer
+static inline void set_int(struct bus *b, int i, int32_t val)
+{
+   if (b->int_mem[i] != val) {
+      b->int_mem[i] = val;
+      __atomic_fetch_or(&b->int_dirty, 1u << i, __ATOMIC_RELEASE);
+   }
+}
+
+static inline void set_float(struct bus *b, int i, float val)
+{
+   if (b->float_mem[i] != val) {
+      b->float_mem[i] = val;
+      __atomic_fetch_or(&b->float_dirty, 1u << i, __ATOMIC_RELEASE);
+   }
+}
+
+static inline void set_aux(struct bus *b, int i, float val)
+{
+   if (b->aux_mem[i] != val) {
+      b->aux_mem[i] = val;
+      __atomic_fetch_or(&b->aux_dirty, 1u << i, __ATOMIC_RELEASE);
+   }
+}
+
+static inline void set_switch(struct bus *b, int i, bool val)
+{
+   if (b->switches[i] != val) {
+      b->switches[i] = val;
+      __atomic_fetch_or(&b->switch_dirty, 1u << i, __ATOMIC_RELEASE);
+   }
+}
+
+// count the changes of switch i, from the first value decoded
+static inline void switch_track(struct bus *b, int i, bool val)
+{
+   if (!(b->switch_seen & 1u << i)) {
+      b->switch_seen |= 1u << i;
+      b->switch_first[i] = val;
+   } else if (b->switches[i] != val)
+      b->switch_toggles[i]++;
+}
+
+static inline void set_misc(struct bus *b, int i)
+{
+   __atomic_fetch_or(&b->misc_dirty, 1u << i, __ATOMIC_RELEASE);
+}
+
+// move window win of an aggregate on to the bucket now falls into
+static void agg_advance(struct agg_window *w, int win, uint64_t now)
+{
+   uint64_t len = agg_window_us[win] / AGG_BUCKETS;
+   uint64_t epoch = now / len;
+
+   w->cur = epoch % AGG_BUCKETS;
+   w->end_us = (epoch + 1) * len;
+   memset(&w->bucket[w->cur], 0, sizeof(w->bucket[0]));
+   w->bucket[w->cur].epoch = epoch;
+}
+
+// add a sample of agg slot i, O(1) for all time and every window
+static inline void agg_add(struct bus *b, int i, float val, uint64_t now)
+{
+   struct agg *a = &b->agg[i];
+   struct agg_bucket *k;
+   double d;
+   int w;
+
+   if (a->n == 0 || val < a->min) {
+      a->min = val;
+      __atomic_fetch_or(&b->extrema_dirty, 1u << i, __ATOMIC_RELEASE);
+   }
+   if (a->n == 0 || val > a->max) {
+      a->max = val;
+      __atomic_fetch_or(&b->extrema_dirty, 1u << i, __ATOMIC_RELEASE);
+   }
+   a->n++;
+   d = val - a->mean;
+   a->mean += d / a->n;
+   a->m2 += d * (val - a->mean);
+
+   for (w = 0; w < AGG_WINDOWS; w++) {
+      // frames stamped a little back in time go into the current bucket
+      if (now >= a->win[w].end_us)
+	 agg_advance(&a->win[w], w, now);
+      k = &a->win[w].bucket[a->win[w].cur];
+      if (k->n == 0 || val < k->min)
+	 k->min = val;
+      if (k->n == 0 || val > k->max)
+	 k->max = val;
+      k->n++;
+      k->sum += val;
+      k->sum2 += (double) val * val;
+   }
+}
+
+// all time statistics of agg slot i
+static void agg_total(const struct bus *b, int i, struct agg_stats *st)
+{
+   const struct agg *a = &b->agg[i];
+
+   st->n = a->n;
+   st->min = a->min;
+   st->max = a->max;
+   st->mean = a->mean;
+   st->sd = a->n ? sqrt(a->m2 / a->n) : 0.;
+}
+
+// statistics of agg slot i over window win, up to now
+static void agg_window(const struct bus *b, int i, int win, uint64_t now,
+      struct agg_stats *st)
+{
+   const struct agg_bucket *k;
+   uint64_t epoch = now / (agg_window_us[win] / AGG_BUCKETS);
+   double sum = 0., sum2 = 0., var;
+   int j;
+
+   memset(st, 0, sizeof(*st));
+   for (j = 0; j < AGG_BUCKETS; j++) {
+      k = &b->agg[i].win[win].bucket[j];
+      if (k->n == 0 || k->epoch > epoch || k->epoch + AGG_BUCKETS <= epoch)
+	 continue;
+      if (st->n == 0 || k->min < st->min)
+	 st->min = k->min;
+      if (st->n == 0 || k->max > st->max)
+	 st->max = k->max;
+      st->n += k->n;
+      sum += k->sum;
+      sum2 += k->sum2;
+   }
+   if (st->n) {
+      st->mean = sum / st->n;
+      var = sum2 / st->n - st->mean * st->mean;
+      st->sd = var > 0. ? sqrt(var) : 0.;
+   }
+}
+
+// the trip counters reset from outside, by key or signal
+static inline void trip_check_reset(struct bus *b)
+{
+   if (__atomic_load_n(&b->trip_reset, __ATOMIC_RELAXED)) {
+      __atomic_store_n(&b->trip_reset, 0, __ATOMIC_RELAXED);
+      memset(&b->trip[TRIP_A], 0, sizeof(b->trip[TRIP_A]));
+      set_misc(b, TRIP_DATA);
+   }
+}
+
+// integrate fuel at lph litres per hour and engine time up to now,
+// trapezoidal from the previous sample
+static void trip_fuel(struct bus *b, float lph, uint64_t now)
+{
+   double dt;
+   int i;
+
+   trip_check_reset(b);
+   if (b->fuel_us != 0 && now > b->fuel_us && now - b->fuel_us < TRIP_MAX_GAP_US) {
+      dt = (now - b->fuel_us) * 1.e-6;
+      for (i = 0; i < TRIP_COUNT; i++) {
+	 b->trip[i].fuel_l += (b->fuel_lph + lph) / 2. * dt / 3600.;
+	 if (b->int_mem[RPM] > 0)
+	    b->trip[i].engine_s += dt;
+      }
+      set_misc(b, TRIP_DATA);
+   } else if (b->fuel_first_us == 0) {
+      b->fuel_first_us = now;
+      b->fuel_first_lph = lph;
+      b->fuel_first_engine = b->int_mem[RPM] > 0;
+   }
+   b->fuel_us = now;
+   b->fuel_lph = lph;
+}
+
+// integrate distance at kmh up to now, the same way
+static void trip_distance(struct bus *b, float kmh, uint64_t now)
+{
+   double dt;
+   int i;
+
+   trip_check_reset(b);
+   if (b->dist_us != 0 && now > b->dist_us && now - b->dist_us < TRIP_MAX_GAP_US) {
+      dt = (now - b->dist_us) * 1.e-6;
+      for (i = 0; i < TRIP_COUNT; i++) {
+	 b->trip[i].dist_km += (b->speed_kmh + kmh) / 2. * dt / 3600.;
+	 if (kmh > 0. || b->speed_kmh > 0.)
+	    b->trip[i].moving_s += dt;
+      }
+      set_misc(b, TRIP_DATA);
+   } else if (b->dist_first_us == 0) {
+      b->dist_first_us = now;
+      b->dist_first_kmh = kmh;
+   }
+   b->dist_us = now;
+   b->speed_kmh = kmh;
+}
+
+static void post_vcds_speeds(struct bus *b)
+{
+   // distance from the mean of all wheels
+   trip_distance(b, (b->float_mem[SPEED_F_L] + b->float_mem[SPEED_F_R] +
+	    b->float_mem[SPEED_R_L] + b->float_mem[SPEED_R_R]) / 4., b->last_frame_us);
+   // now check tire preassures
+   tpms_update(b, b->last_frame_us);
+}
+
+// fuel consumption
+static void post_ecu_600(struct bus *b)
+{
+   float lphr, lph;
+
+   // compute l/h
+   // each rev sees two injections
+   lphr = 2 * b->int_mem[FUEL]; // mm^3
+   // each minute has rpm revs
+   lphr *= b->int_mem[RPM];
+   // now include mm^3 -> l factor and 60mins
+   lphr *= 1.e-6;
+   lphr *= 60;
+   // add fudge factor...
+   lphr /= FUELFUDGE;
+   // compute l/1ookm
+   // start w/ liters per hour
+   lph = lphr;
+   // normalise km/h to achieve 100km, there is no such thing standing still
+   if (b->float_mem[SPEED_F_L] >= 1.) {
+      lph /= b->float_mem[SPEED_F_L];
+      lph *= 100;
+   } else
+      lph = NAN;
+   set_aux(b, FUEL_LPH, lphr);
+   set_aux(b, FUEL_L100KM, lph);
+   trip_fuel(b, lphr, b->last_frame_us);
+}
+
+// keep track of when a known frame arrives and whether its rolling counter
+// says we missed some
+static inline void timing_gap(struct frame_stats *st, uint64_t dt)
+{
+   int b;
+
+   b = dt ? 63 - __builtin_clzll(dt) : 0;
+   st->hist[b < HIST_BUCKETS ? b : HIST_BUCKETS - 1]++;
+   st->sum_dt += dt;
+   st->sum_dt2 += (double) dt * dt;
+   if (dt < st->min_dt)
+      st->min_dt = dt;
+   if (dt > st->max_dt)
+      st->max_dt = dt;
+}
+
+// the counter went from cnt_last to cnt
+static inline void counter_step(const struct frame_plan *f, struct frame_stats *st,
+      uint64_t cnt)
+{
+   uint64_t step;
+
+   step = (cnt - st->cnt_last) & f->cnt_mask;
+   if (step == 0)
+      st->cnt_dups++;
+   else if (step > 1) {
+      st->cnt_gaps++;
+      st->cnt_lost += step - 1;
+   }
+}
+
+static inline void frame_timing(const struct frame_plan *f, struct frame_stats *st,
+      uint64_t now, uint64_t le, uint64_t be)
+{
+   uint64_t cnt;
+
+   if (st->count == 0) {
+      st->first_us = now;
+      st->min_dt = UINT64_MAX;
+   } else
+      timing_gap(st, now > st->last_us ? now - st->last_us : 0);
+   st->last_us = now;
+
+   if (f->cnt_mask) {
+      cnt = ((f->cnt_flags & SIG_BIG_ENDIAN ? be : le) >> f->cnt_shift) & f->cnt_mask;
+      if (st->count)
+	 counter_step(f, st, cnt);
+      else
+	 st->cnt_first = cnt;
+      st->cnt_last = cnt;
+   }
+   st->count++;
+}
+
+// per ID timing and counter statistics, for the end of a session
+static void report_timing(struct bus *b, FILE *out)
+{
+   const struct frame_stats *st;
+   double mean, jitter, rate;
+   int i, h;
+
+   fprintf(out, "frame timing:\n");
+   fprintf(out, "  id      frames     rate/s  mean ms   min ms   max ms jitter ms   lost  gaps  dups\n");
+   for (i = 0; i < decode_nframes; i++) {
+      st = &b->stats[i];
+      if (st->count == 0)
+	 continue;
+      mean = jitter = rate = 0.;
+      if (st->count > 1) {
+	 mean = (double) st->sum_dt / (st->count - 1);
+	 jitter = st->sum_dt2 / (st->count - 1) - mean * mean;
+	 jitter = jitter > 0. ? sqrt(jitter) : 0.;
+	 if (st->last_us > st->first_us)
+	    rate = (st->count - 1) * 1.e6 / (st->last_us - st->first_us);
+      }
+      fprintf(out, "  %03x %10lu %10.2f %8.3f %8.3f %8.3f %9.3f",
+	    decode_frames[i].id, (unsigned long) st->count, rate, mean * 1.e-3,
+	    st->count > 1 ? st->min_dt * 1.e-3 : 0., st->max_dt * 1.e-3, jitter * 1.e-3);
+      if (decode_frames[i].cnt_mask)
+	 fprintf(out, " %6u %5u %5u", st->cnt_lost, st->cnt_gaps, st->cnt_dups);
+      fprintf(out, "\n");
+      // where the inter-arrival times fall
+      fprintf(out, "      ");
+      for (h = 0; h < HIST_BUCKETS; h++)
+	 if (st->hist[h])
+	    fprintf(out, " %s%luus:%u", h == HIST_BUCKETS - 1 ? ">=" : "",
+		  1UL << h, st->hist[h]);
+      fprintf(out, "\n");
+   }
+}
+
+// add a frame and its signals to the decode plan
+static int plan_frame(uint16_t id, void (*post)(struct bus *),
+      const struct signal_def *sigs, int nsigs)
+{
+   struct frame_plan *f;
+   struct sig_plan *p;
+   int i, shift;
+
+   if (id > CAN_SFF_MASK || decode_index[id] != 0) {
+      fprintf(stderr, "frame %03x defined twice\n", id);
+      return 1;
+   }
+   f = &decode_frames[decode_nframes];
+   f->id = id;
+   f->first = decode_nsigs;
+   f->count = 0;
+   f->cnt_mask = 0;
+   f->post = post;
+   for (i = 0; i < nsigs; i++) {
+      if (sigs[i].id != id || (sigs[i].target == T_NONE && !(sigs[i].flags & SIG_COUNTER)))
+	 continue;
+      if (decode_nsigs == MAX_SIGNALS) {
+	 fprintf(stderr, "too many signals\n");
+	 return 1;
+      }
+      // big endian signals are contiguous in the byte swapped frame,
+      // counting from its lsb the msb sits at (7 - byte) * 8 + bit
+      if (sigs[i].flags & SIG_BIG_ENDIAN)
+	 shift = (7 - sigs[i].start / 8) * 8 + sigs[i].start % 8 - sigs[i].len + 1;
+      else
+	 shift = sigs[i].start;
+      if (sigs[i].len < 1 || sigs[i].len > 64 || shift < 0 || shift + sigs[i].len > 64) {
+	 fprintf(stderr, "frame %03x: bad signal at bit %d\n", id, sigs[i].start);
+	 return 1;
+      }
+      if (sigs[i].flags & SIG_COUNTER) {
+	 f->cnt_shift = shift;
+	 f->cnt_flags = sigs[i].flags;
+	 f->cnt_mask = sigs[i].len == 64 ? ~0ULL : (1ULL << sigs[i].len) - 1;
+	 if (sigs[i].target == T_NONE)
+	    continue;
+      }
+      p = &decode_sigs[decode_nsigs++];
+      p->shift = shift;
+      p->len = sigs[i].len;
+      p->mask = sigs[i].len == 64 ? ~0ULL : (1ULL << sigs[i].len) - 1;
+      p->flags = sigs[i].flags;
+      p->scale = sigs[i].scale;
+      p->offset = sigs[i].offset;
+      p->target = sigs[i].target;
+      p->slot = sigs[i].slot;
+      f->count++;
+   }
+   decode_index[id] = ++decode_nframes;
+   return 0;
+}
+
+// the post hook the built-in tables have for a frame, if any
+static void (*builtin_post(uint16_t id))(struct bus *)
+{
+   int i;
+
+   for (i = 0; i < (int) (sizeof(builtin_frames)/sizeof(builtin_frames[0])); i++)
+      if (builtin_frames[i].id == id)
+	 return builtin_frames[i].post;
+   return NULL;
+}
+
+// find the value a DBC signal name refers to, T_NONE if we have none
+static void bind_signal(const char *name, struct signal_def *sig)
+{
+   static const struct {
+      uint8_t target;
+      int count;
+      const char **names;
+   } slots[] = {
+      { T_INT,    INT_COUNT,    int_names },
+      { T_FLOAT,  FLOAT_COUNT,  float_names },
+      { T_AUX,    AUX_COUNT,    aux_names },
+      { T_SWITCH, SWITCH_COUNT, switch_names },
+   };
+   int i, j;
+
+   for (i = 0; i < (int) (sizeof(slots)/sizeof(slots[0])); i++)
+      for (j = 0; j < slots[i].count; j++)
+	 if (strcmp(name, slots[i].names[j]) == 0) {
+	    sig->target = slots[i].target;
+	    sig->slot = j;
+	    return;
+	 }
+   sig->target = T_NONE;
+   sig->slot = 0;
+}
+
+// skip blanks within a line
+static const char *skip_blanks(const char *p)
+{
+   while (*p == ' ' || *p == '\t')
+      p++;
+   return p;
+}
+
+// parse the part of a ' SG_ ' line after the keyword
+// 'NAME [MUX] : START|LEN@ORDER SIGN (SCALE,OFFSET) [MIN|MAX] "UNIT" RECEIVERS'
+// returns 0 for a signal, 1 for one we skip (multiplexed), -1 on errors
+static int dbc_signal(const char *p, struct signal_def *sig)
+{
+   char name[128];
+   char *q;
+   long start, len;
+   int n, mux = 0;
+
+   p = skip_blanks(p);
+   for (n = 0; *p && *p != ' ' && *p != '\t' && *p != ':' && n < (int) sizeof(name) - 1; n++)
+      name[n] = *p++;
+   name[n] = '\0';
+   p = skip_blanks(p);
+   if (*p != ':') {
+      // multiplexer indicator
+      mux = 1;
+      while (*p && *p != ':')
+	 p++;
+   }
+   if (*p++ != ':')
+      return -1;
+   start = strtol(p, &q, 10);
+   if (q == p || *q != '|')
+      return -1;
+   p = q + 1;
+   len = strtol(p, &q, 10);
+   if (q == p || q[0] != '@' || (q[1] != '0' && q[1] != '1') || (q[2] != '+' && q[2] != '-'))
+      return -1;
+   if (start < 0 || start > 63 || len < 1 || len > 64)
+      return -1;
+   sig->start = start;
+   sig->len = len;
+   sig->flags = (q[1] == '0' ? SIG_BIG_ENDIAN : 0) | (q[2] == '-' ? SIG_SIGNED : 0);
+   p = skip_blanks(q + 3);
+   if (*p++ != '(')
+      return -1;
+   sig->scale = strtod(p, &q);
+   if (q == p || *q != ',')
+      return -1;
+   p = q + 1;
+   sig->offset = strtod(p, &q);
+   if (q == p || *q != ')')
+      return -1;
+   if (mux)
+      return 1;
+   bind_signal(name, sig);
+   // by convention, *COUNTER signals are rolling counters
+   n = strlen(name);
+   if (n >= 7 && strcmp(name + n - 7, "COUNTER") == 0)
+      sig->flags |= SIG_COUNTER;
+   return 0;
+}
+
+// load a DBC file and compile its messages into the decode plan
+// we only look at BO_ and SG_ lines, everything else is skipped
+static int dbc_load(const char *fname)
+{
+   struct signal_def *sigs = NULL, *sig;
+   struct stat st;
+   char *buf, *p, *eol;
+   long id = -1;
+   int fd, nsigs = 0, maxsigs = 0, ret = 0, lineno = 0;
+   int frames = 0, total = 0, bound = 0, skipped = 0;
+
+   fd = open(fname, O_RDONLY);
+   if (fd < 0) {
+      perror(fname);
+      return 1;
+   }
+   if (fstat(fd, &st) < 0 || (buf = malloc(st.st_size + 1)) == NULL) {
+      perror(fname);
+      close(fd);
+      return 1;
+   }
+   if (read(fd, buf, st.st_size) != st.st_size) {
+      perror(fname);
+      close(fd);
+      free(buf);
+      return 1;
+   }
+   close(fd);
+   buf[st.st_size] = '\0';
+
+   decode_nsigs = decode_nframes = 0;
+   memset(decode_index, 0, sizeof(decode_index));
+
+   for (p = buf; p && *p && ret == 0; p = eol) {
+      eol = strchr(p, '\n');
+      if (eol)
+	 *eol++ = '\0';
+      lineno++;
+      if (strncmp(p, "BO_ ", 4) == 0) {
+	 // flush the previous message
+	 if (id >= 0 && (ret = plan_frame(id, builtin_post(id), sigs, nsigs)) != 0)
+	    break;
+	 nsigs = 0;
+	 id = strtol(p + 4, NULL, 10);
+	 if (id < 0 || id > CAN_SFF_MASK) {
+	    // extended frames and the like, skip their signals
+	    id = -1;
+	    skipped++;
+	    continue;
+	 }
+	 frames++;
+      } else if (strncmp(skip_blanks(p), "SG_ ", 4) == 0) {
+	 total++;
+	 if (id < 0) {
+	    skipped++;
+	    continue;
+	 }
+	 if (nsigs == maxsigs) {
+	    maxsigs = maxsigs ? 2*maxsigs : 64;
+	    sig = realloc(sigs, maxsigs * sizeof(*sigs));
+	    if (sig == NULL) {
+	       perror("realloc");
+	       ret = 1;
+	       break;
+	    }
+	    sigs = sig;
+	 }
+	 sig = &sigs[nsigs];
+	 sig->id = id;
+	 switch (dbc_signal(skip_blanks(p) + 4, sig)) {
+	 case 0:
+	    nsigs++;
+	    if (sig->target != T_NONE)
+	       bound++;
+	    break;
+	 case 1:
+	    skipped++;
+	    break;
+	 default:
+	    fprintf(stderr, "%s:%d: cannot parse signal\n", fname, lineno);
+	    ret = 1;
+	 }
+      }
+   }
+   if (ret == 0 && id >= 0)
+      ret = plan_frame(id, builtin_post(id), sigs, nsigs);
+
+   free(sigs);
+   free(buf);
+   if (ret == 0)
+      fprintf(stderr, "%s: %d frames, %d signals, %d decoded, %d skipped\n",
+	    fname, frames, total, bound, skipped);
+   return ret;
+}
+
+// a frame whose payload did not change decodes to the values it left in
+// its slots last time, unless another frame wrote them in between, so
+// only frames that have their slots to themselves can skip decoding
+// post hooks compute aux values, frames with aux signals never skip then
+static void plan_cache(void)
+{
+   uint16_t writers[T_NONE][256];
+   const struct sig_plan *p, *last;
+   int i, hooks = 0;
+
+   memset(writers, 0, sizeof(writers));
+   for (i = 0; i < decode_nframes; i++) {
+      hooks |= decode_frames[i].post != NULL;
+      for (p = &decode_sigs[decode_frames[i].first], last = p + decode_frames[i].count;
+	    p < last; p++)
+	 if (p->target < T_NONE)
+	    writers[p->target][p->slot]++;
+   }
+   for (i = 0; i < decode_nframes; i++) {
+      decode_frames[i].cacheable = 1;
+      for (p = &decode_sigs[decode_frames[i].first], last = p + decode_frames[i].count;
+	    p < last; p++)
+	 if (p->target < T_NONE &&
+	       (writers[p->target][p->slot] > 1 || (p->target == T_AUX && hooks)))
+	    decode_frames[i].cacheable = 0;
+   }
+}
+
+// compile the DBC file or else the built-in tables into the decode plan
+static int decoder_init(const char *dbc)
+{
+   int i;
+
+   if (dbc != NULL) {
+      if (dbc_load(dbc))
+	 return 1;
+      plan_cache();
+      return 0;
+   }
+
+   decode_nsigs = decode_nframes = 0;
+   memset(decode_index, 0, sizeof(decode_index));
+   for (i = 0; i < (int) (sizeof(builtin_frames)/sizeof(builtin_frames[0])); i++)
+      if (plan_frame(builtin_frames[i].id, builtin_frames[i].post, builtin_signals,
+	       sizeof(builtin_signals)/sizeof(builtin_signals[0])))
+	 return 1;
+   plan_cache();
+   return 0;
+}
+
+// process single CAN frame, stamp is the time the frame was seen on the bus
+// this only decodes into the values of bus b, painting the screen is up to
+// render()
+// the value of signal p in a payload, both ways round
+static inline double sig_value(const struct sig_plan *p, uint64_t le, uint64_t be)
+{
+	uint64_t raw = ((p->flags & SIG_BIG_ENDIAN ? be : le) >> p->shift) & p->mask;
+	double val;
+
+	if (p->flags & SIG_SIGNED)
+	   val = (double) ((int64_t) (raw << (64 - p->len)) >> (64 - p->len));
+	else
+	   val = (double) raw;
+	return val * p->scale + p->offset;
+}
+
+static void process_one(struct bus *b, struct can_frame *frm, const struct timeval *stamp)
+{
+	const struct frame_plan *f;
+	const struct sig_plan *p, *last;
+	struct frame_stats *st;
+	uint64_t le, be, now = stamp_us(stamp);
+	double val;
+	int idx = 0;
+#ifdef PROF
+	uint64_t t0 = prof_now(), t1;
+
+	if (prof_live) {
+	   prof_add(&prof[PROF_QUEUE], prof_age_us(now));
+	   if (sink->screen && b->prof_render_us == 0)
+	      __atomic_store_n(&b->prof_render_us, now, __ATOMIC_RELEASE);
+	}
+#endif
+
+	if (!(frm->can_id & (CAN_EFF_FLAG | CAN_RTR_FLAG | CAN_ERR_FLAG)))
+	   idx = decode_index[frm->can_id];
+
+	// post hooks go by this too
+	__atomic_store_n(&b->last_frame_us, now, __ATOMIC_RELEASE);
+
+	if (idx) {
+	   f = &decode_frames[idx - 1];
+	   memcpy(&le, frm->data, sizeof(le));
+	   be = be64toh(le);
+	   le = le64toh(le);
+	   st = &b->stats[idx - 1];
+	   frame_timing(f, st, now, le, be);
+	   p = &decode_sigs[f->first];
+	   last = p + f->count;
+	   if (st->cached && st->last_le == le && st->last_dlc == frm->can_dlc &&
+		 f->cacheable && !decode_full) {
+	      // same payload, same values, only the aggregates see the frame
+	      st->unchanged++;
+	      for (; p < last; p++)
+		 if (p->target == T_INT)
+		    agg_add(b, p->slot, b->int_mem[p->slot], now);
+		 else if (p->target == T_FLOAT)
+		    agg_add(b, INT_COUNT + p->slot, b->float_mem[p->slot], now);
+	      p = last;
+	   }
+	   st->last_le = le;
+	   st->last_dlc = frm->can_dlc;
+	   st->cached = 1;
+	   for (; p < last; p++) {
+	      val = sig_value(p, le, be);
+	      switch (p->target) {
+	      case T_INT:
+		 set_int(b, p->slot, (int32_t) val);
+		 agg_add(b, p->slot, b->int_mem[p->slot], now);
+		 b->int_known |= 1u << p->slot;
+		 break;
+	      case T_FLOAT:
+		 set_float(b, p->slot, val);
+		 agg_add(b, INT_COUNT + p->slot, b->float_mem[p->slot], now);
+		 b->float_known |= 1u << p->slot;
+		 break;
+	      case T_AUX:
+		 set_aux(b, p->slot, val);
+		 break;
+	      case T_SWITCH:
+		 switch_track(b, p->slot, val != 0.);
+		 set_switch(b, p->slot, val != 0.);
+		 break;
+	      }
+	   }
+	   if (f->post)
+	      f->post(b);
+	   if (b->shm)
+	      shm_publish(b, f, now);
+	} else
+	   unknown_frame(b, frm, now);
+#ifdef PROF
+	t1 = prof_now();
+	prof_add(&b->stats[idx ? idx - 1 : decode_nframes].decode, t1 - t0);
+#endif
+
+	b->frames++;
+
+	b->display += 1;
+	if (b->display%5 == 0)
+	{
+	   // quiet buses still count, so output picks up in step after a seek
+	   if (!b->quiet)
+	      sink_line(b, now, stamp);
+	   b->display = 0;
+#ifdef PROF
+	   if (!b->quiet) {
+	      prof_add(&prof[PROF_OUTPUT], prof_now() - t1);
+	      if (prof_live && !sink->screen)
+		 prof_add(&prof[PROF_DUMP], prof_age_us(now));
+	   }
+#endif
+	}
+}
+
+// one line of dump output with the means over window win
+static void print_window(struct bus *b, int win, const struct timeval *stamp)
+{
+   struct agg_stats st;
+   int32_t ints[INT_COUNT];
+   float floats[FLOAT_COUNT];
+   int i;
+
+   for (i = 0; i < INT_COUNT; i++) {
+      agg_window(b, i, win, stamp_us(stamp), &st);
+      ints[i] = lrint(st.mean);
+   }
+   for (i = 0; i < FLOAT_COUNT; i++) {
+      agg_window(b, INT_COUNT + i, win, stamp_us(stamp), &st);
+      floats[i] = st.mean;
+   }
+   print_columns(nbuses > 1 ? b->name : NULL, stamp, ints, floats, b->switches);
+}
+
+// write out the dump lines formatted so far, stdio never sees them
+static void dump_flush(void)
+{
+   size_t done = 0;
+   ssize_t n;
+
+   while (done < dump.len) {
+      n = write(fileno(stdout), dump.buf + done, dump.len - done);
+      if (n < 0 && errno == EINTR)
+	 continue;
+      if (n <= 0) {
+	 // a reader that went away is not worth stopping the decoder for
+	 perror("dump output");
+	 break;
+      }
+      done += n;
+   }
+   dump.len = 0;
+}
+
+// v as a decimal with the given number of decimals, right aligned in
+// width characters like printf's %*.*f would do, p has room for 64
+static inline char *fmt_fixed(char *p, uint64_t v, int decimals, bool neg, int width)
+{
+   char tmp[32], *t = tmp + sizeof(tmp);
+   int i;
+
+   for (i = 0; i < decimals; i++) {
+      *--t = '0' + v % 10;
+      v /= 10;
+   }
+   if (decimals)
+      *--t = '.';
+   do {
+      *--t = '0' + v % 10;
+      v /= 10;
+   } while (v);
+   if (neg)
+      *--t = '-';
+   for (i = tmp + sizeof(tmp) - t; i < width; i++)
+      *p++ = ' ';
+   memcpy(p, t, tmp + sizeof(tmp) - t);
+   return p + (tmp + sizeof(tmp) - t);
+}
+
+// %*.2f of a float without stdio: 24 bits of mantissa times 100 are exact
+// in a double, so rounding that to nearest even rounds like printf does
+static inline char *fmt_float(char *p, float f, int width)
+{
+   double v = f;
+
+   if (!isfinite(v) || fabs(v) >= 1.e15)
+      return p + snprintf(p, 64, "%*.2f", width, v);
+   v = nearbyint(v * 100.);
+   return fmt_fixed(p, (uint64_t) fabs(v), 2, signbit(f), width);
+}
+
+// zero padded to digits
+static inline char *fmt_zeros(char *p, uint64_t v, int digits)
+{
+   int i;
+
+   for (i = digits - 1; i >= 0; i--) {
+      p[i] = '0' + v % 10;
+      v /= 10;
+   }
+   return p + digits;
+}
+
+// CSV and TSV say what is in which column first
+static void dump_header(const char *bus, char sep)
+{
+   char *p = dump.buf + dump.len;
+   int i;
+
+   if (bus)
+      p += sprintf(p, "bus%c", sep);
+   p += sprintf(p, "time");
+   for (i = 0; i < INT_COUNT; i++)
+      p += sprintf(p, "%c%s", sep, int_names[i]);
+   for (i = 0; i < FLOAT_COUNT; i++)
+      p += sprintf(p, "%c%s", sep, float_names[i]);
+   for (i = 0; i < SWITCH_COUNT; i++)
+      p += sprintf(p, "%c%s", sep, switch_names[i]);
+   *p++ = '\n';
+   dump.len = p - dump.buf;
+   dump.header = 1;
+}
+
+// one line of dump output, several buses get their name in front
+// columns are padded to line up, CSV and TSV are not
+static void print_columns(const char *bus, const struct timeval *stamp,
+      const int32_t *ints, const float *floats, const bool *sw)
+{
+   char *p, sep = dump.format == DUMP_CSV ? ',' : dump.format == DUMP_TSV ? '\t' : ' ';
+   int i, iw = 0, fw = 0;
+   size_t n;
+
+   if (dump.len > DUMP_BUF_SIZE - DUMP_LINE_MAX)
+      dump_flush();
+   if (dump.format != DUMP_COLUMNS && !dump.header)
+      dump_header(bus, sep);
+   p = dump.buf + dump.len;
+   if (bus) {
+      n = strnlen(bus, IFNAMSIZ);
+      memcpy(p, bus, n);
+      p += n;
+      *p++ = sep;
+   }
+   p = fmt_zeros(p, stamp->tv_sec, 10);
+   *p++ = '.';
+   p = fmt_zeros(p, stamp->tv_usec, 6);
+   if (dump.format == DUMP_COLUMNS) {
+      *p++ = ' ';
+      iw = 5;
+      fw = 7;
+   }
+   for (i = 0; i < INT_COUNT; i++) {
+      *p++ = sep;
+      p = fmt_fixed(p, ints[i] < 0 ? -(int64_t) ints[i] : ints[i], 0, ints[i] < 0, iw);
+   }
+   for (i = 0; i < FLOAT_COUNT; i++) {
+      *p++ = sep;
+      p = fmt_float(p, floats[i], fw);
+   }
+   for (i = 0; i < SWITCH_COUNT; i++) {
+      *p++ = sep;
+      *p++ = '0' + sw[i];
+   }
+   *p++ = '\n';
+   dump.len = p - dump.buf;
+}
+
+// start a helper thread, signals are left to the main thread
+static int start_thread(pthread_t *tid, void *(*fn)(void *), void *arg)
+{
+   sigset_t block, old;
+   int ret;
+
+   sigemptyset(&block);
+   sigaddset(&block, SIGINT);
+   sigaddset(&block, SIGTERM);
+   pthread_sigmask(SIG_BLOCK, &block, &old);
+   ret = pthread_create(tid, NULL, fn, arg);
+   pthread_sigmask(SIG_SETMASK, &old, NULL);
+   return ret;
+}
+
+// one trip counter on the screen
+static void trip_line(const struct trip *t, int y)
+{
+   mvprintw(y, RPM_COL, "%8.2f km %7.2f l ", t->dist_km, t->fuel_l);
+   if (t->dist_km >= 0.1)
+      printw("%6.1f l/1oo km", t->fuel_l / t->dist_km * 100.);
+   else
+      printw("   --- l/1oo km");
+   printw(" %6.1f km/h %3d:%02d h",
+	 t->moving_s > 0. ? t->dist_km / t->moving_s * 3600. : 0.,
+	 (int) (t->engine_s / 3600.), (int) (t->engine_s / 60.) % 60);
+}
+
+// paint whatever the decoder changed on bus b since the last call
+static void render(struct bus *b)
+{
+   static unsigned int ticks;
+   static const char *tpms_warn[4] = {
+      "CHECK PREASSURE OF FRONT LEFT WHEEL!",
+      "CHECK PREASSURE OF FRONT RIGHT WHEEL!",
+      "CHECK PREASSURE OF REAR LEFT WHEEL!",
+      "CHECK PREASSURE OF REAR RIGHT WHEEL!",
+   };
+   uint32_t di, df, da, ds, dm, dx;
+   uint64_t now;
+   int i;
+#ifdef PROF
+   uint64_t oldest = __atomic_exchange_n(&b->prof_render_us, 0, __ATOMIC_ACQUIRE);
+#endif
+
+   di = __atomic_exchange_n(&b->int_dirty, 0, __ATOMIC_ACQUIRE);
+   df = __atomic_exchange_n(&b->float_dirty, 0, __ATOMIC_ACQUIRE);
+   da = __atomic_exchange_n(&b->aux_dirty, 0, __ATOMIC_ACQUIRE);
+   ds = __atomic_exchange_n(&b->switch_dirty, 0, __ATOMIC_ACQUIRE);
+   dm = __atomic_exchange_n(&b->misc_dirty, 0, __ATOMIC_ACQUIRE);
+   dx = __atomic_exchange_n(&b->extrema_dirty, 0, __ATOMIC_ACQUIRE);
+#define D(mask, slot) ((mask) & (1u << (slot)))
+
+   if (D(di, STEER_VAL))
+      mvprintw(STEER_LINE, STEER_COL, "%7d", b->int_mem[STEER_VAL]);
+   if (D(di, STEER_ANGLE))
+      mvprintw(STEER_LINE+1, STEER_COL, "%7d DEG", b->int_mem[STEER_ANGLE]);
+
+   if (D(da, YAW_RATE) || D(df, A_Y))
+      mvprintw(ACCEL_LINE, RPM_COL, "yaw rate  %7.3f deg/s     y_accel %7.3f g",
+	    b->aux_mem[YAW_RATE], b->float_mem[A_Y]);
+   if (D(da, Y_BYTE6))
+      mvprintw(ACCEL_LINE, col-13, "%5d", (int) b->aux_mem[Y_BYTE6]);
+   if (D(da, Y_BYTE7))
+      mvprintw(ACCEL_LINE, col-5, "%5d", (int) b->aux_mem[Y_BYTE7]);
+   if (D(dx, INT_COUNT + A_Y)) {
+      mvprintw(MINMAX_LINE+1, RPM_COL+21, "rig %7.4f y_accel", b->agg[INT_COUNT + A_Y].max);
+      mvprintw(MINMAX_LINE, RPM_COL+21, "lef %7.4f y_accel", b->agg[INT_COUNT + A_Y].min);
+   }
+
+   if (D(da, YAW_ACCEL) || D(df, A_X))
+      mvprintw(ACCEL_LINE+1, RPM_COL, "yaw accel %7.3f deg/s^2   x_accel %7.3f g",
+	    b->aux_mem[YAW_ACCEL], b->float_mem[A_X]);
+   if (D(da, X_BYTE6))
+      mvprintw(ACCEL_LINE+1, col-13, "%5d", (int) b->aux_mem[X_BYTE6]);
+   if (D(da, X_BYTE7))
+      mvprintw(ACCEL_LINE+1, col-5, "%5d", (int) b->aux_mem[X_BYTE7]);
+   if (D(dx, INT_COUNT + A_X)) {
+      mvprintw(MINMAX_LINE+1, RPM_COL+45, "dec %7.4f x_accel", b->agg[INT_COUNT + A_X].max);
+      mvprintw(MINMAX_LINE, RPM_COL+45, "acc %7.4f x_accel", b->agg[INT_COUNT + A_X].min);
+   }
+
+   if (D(di, RPM))
+      mvprintw(ENGINE_LINE, RPM_COL, "%5d rpm", b->int_mem[RPM]);
+   if (D(df, ACCEL))
+      mvprintw(ENGINE_LINE, ACCEL_COL, "%6.2f %%", b->float_mem[ACCEL]);
+   if (D(df, TRANS_TORQ) || D(df, ENGINE_TORQ) || D(df, TORQ_LOSS))
+      mvprintw(TORQUE_LINE+1, RPM_COL, "%5.1f Nm %5.1f Nm %5.1f Nm   %5.1f",
+	    b->float_mem[TRANS_TORQ], b->float_mem[ENGINE_TORQ], b->float_mem[TORQ_LOSS],
+	    b->float_mem[TRANS_TORQ] - b->float_mem[ENGINE_TORQ]);
+   if (D(di, GEAR))
+      mvprintw(AVG_SPEED_LINE, MID_WHL, "gear: %1d", b->int_mem[GEAR]);
+
+   if (D(df, SPEED))
+      mvprintw(AVG_SPEED_LINE, LEFT_WHL, "%5.2f km/h", b->float_mem[SPEED]);
+   if (D(da, SPEED_CNT))
+      mvprintw(AVG_SPEED_LINE, col-5, "%5d", (int) b->aux_mem[SPEED_CNT]);
+   if (D(df, SPEED_F_L) || D(df, SPEED_F_R) || D(df, SPEED_R_L) || D(df, SPEED_R_R)) {
+      mvprintw(IND_SPEED_LINE, LEFT_WHL, "%5.2f km/h", b->float_mem[SPEED_F_L]);
+      mvprintw(IND_SPEED_LINE, RIGHT_WHL, "%5.2f km/h", b->float_mem[SPEED_F_R]);
+      mvprintw(IND_SPEED_LINE, MID_WHL, "%5.2f",
+	    ((b->float_mem[SPEED_F_R]-b->float_mem[SPEED_F_L]) * 0.05625));
+      mvprintw(IND_SPEED_LINE+1, LEFT_WHL, "%5.2f",
+	    ((b->float_mem[SPEED_F_L]-b->float_mem[SPEED_R_L]) * 0.05625));
+      mvprintw(IND_SPEED_LINE+1, RIGHT_WHL, "%5.2f",
+	    ((b->float_mem[SPEED_F_R]-b->float_mem[SPEED_R_R]) * 0.05625));
+      mvprintw(IND_SPEED_LINE+2, LEFT_WHL, "%5.2f km/h", b->float_mem[SPEED_R_L]);
+      mvprintw(IND_SPEED_LINE+2, RIGHT_WHL, "%5.2f km/h", b->float_mem[SPEED_R_R]);
+      mvprintw(IND_SPEED_LINE+2, MID_WHL, "%5.2f",
+	    ((b->float_mem[SPEED_R_R]-b->float_mem[SPEED_R_L]) * 0.05625));
+   }
+
+   if (D(da, AMB_TEMP))
+      mvprintw(TEMP_LINE, RPM_COL, "%5.1f degC", b->aux_mem[AMB_TEMP]);
+   if (D(da, TEMP_CNT))
+      mvprintw(TEMP_LINE, col-5, "%5d", (int) b->aux_mem[TEMP_CNT]);
+   if (D(da, COOLANT))
+      mvprintw(TEMP_LINE, COOL_COL, "%5d degC", (int) b->aux_mem[COOLANT]);
+
+   if (D(di, FUEL))
+      mvprintw(FUEL_LINE, RPM_COL, "%5.2f mm3/s", (b->int_mem[FUEL]/FUELFUDGE));
+   if (D(dx, FUEL)) {
+      mvprintw(MINMAX_LINE+1, RPM_COL, "max %5.2f mm3/s", b->agg[FUEL].max/FUELFUDGE);
+      mvprintw(MINMAX_LINE, RPM_COL, "min %5.2f mm3/s", b->agg[FUEL].min/FUELFUDGE);
+   }
+   if (D(da, FUEL_LPH) || D(da, FUEL_L100KM)) {
+      attron(COLOR_PAIR(HIL));
+      if (isnan(b->aux_mem[FUEL_L100KM]))
+	 mvprintw(FUEL_LINE, RPM_COL+25, "   --- l/1oo km");
+      else
+	 mvprintw(FUEL_LINE, RPM_COL+25, "%6.1f l/1oo km", b->aux_mem[FUEL_L100KM]);
+      mvprintw(FUEL_LINE, RPM_COL+12, "%6.1f l/h", b->aux_mem[FUEL_LPH]);
+      attroff(COLOR_PAIR(HIL));
+   }
+   if (D(da, FUEL_CNT))
+      mvprintw(FUEL_LINE, col-5, "%5d", (int) b->aux_mem[FUEL_CNT]);
+
+   if (D(ds, BREAK_SW)) {
+      if (b->switches[BREAK_SW]) {
+	 attron(A_BOLD | COLOR_PAIR(WARN));
+	 mvprintw(row+SWITCHES_LINE, 3, "! BREAK !");
+	 attroff(A_BOLD | COLOR_PAIR(WARN));
+      } else
+	 mvprintw(row+SWITCHES_LINE, 3, "         ");
+   }
+   if (D(ds, CLUTCH_SW)) {
+      if (b->switches[CLUTCH_SW])
+	 mvprintw(row+SWITCHES_LINE, 13, "CLUTCH");
+      else
+	 mvprintw(row+SWITCHES_LINE, 13, "      ");
+   }
+   if (D(ds, DOOR_SW)) {
+      if (b->switches[DOOR_SW]) {
+	 attron(A_BOLD | COLOR_PAIR(WARN));
+	 mvprintw(row+SWITCHES_LINE, 23, " DOOR OPEN ");
+	 attroff(A_BOLD | COLOR_PAIR(WARN));
+      } else
+	 mvprintw(row+SWITCHES_LINE, 23, "           ");
+   }
+
+   if (D(dm, TRIP_DATA))
+      for (i = 0; i < TRIP_COUNT; i++)
+	 trip_line(&b->trip[i], TRIP_LINE + i);
+
+   // the ratios drift slowly, once a second is plenty
+   if (D(dm, TPMS_FLAGS) || ticks % UNKNOWN_SUMMARY_TICKS == 0) {
+      for (i = 0; i < 4; i++) {
+	 // clear text - in case there is one
+	 mvprintw(row+SWITCHES_LINE-4+i, 10, "                                    %+5.2f%% ",
+	       b->tpms.ratio[i] * 100.);
+	 if (b->tpms.low[i]) {
+	    attron(A_BOLD | COLOR_PAIR(WARN) | A_REVERSE);
+	    mvprintw(row+SWITCHES_LINE-4+i, 10, "%s", tpms_warn[i]);
+	    attroff(A_BOLD | COLOR_PAIR(WARN) | A_REVERSE);
+	 }
+      }
+   }
+
+   if (di || df) {
+      now = __atomic_load_n(&b->last_frame_us, __ATOMIC_ACQUIRE);
+      mvprintw(row - 1, 1, "values for file [%010ld.%06ld]:",
+	    (long) (now / 1000000), (long) (now % 1000000));
+      for (i = 0; i < INT_COUNT; i++)
+	 printw(" %5d", b->int_mem[i]);
+      for (i = 0; i < FLOAT_COUNT; i++)
+	 printw(" %7.2f", b->float_mem[i]);
+   }
+#undef D
+
+   if (ticks++ % UNKNOWN_SUMMARY_TICKS == 0)
+      unknown_summary(b);
+
+   refresh();
+#ifdef PROF
+   if (oldest)
+      prof_add(&prof[PROF_RENDER], prof_age_us(oldest));
+#endif
+}
+
+// the name of the bus on screen, if there is a choice
+static void show_bus_name(void)
+{
+   if (nbuses > 1)
+      mvprintw(0, 40, "bus %s (%d/%d), n for next", buses[shown]->name,
+	    shown + 1, nbuses);
+}
+
+// switch the screen to another bus, everything on it needs a repaint
+static void show_bus(int i)
+{
+   struct bus *b = buses[i];
+
+   shown = i;
+   paint_empty_scr();
+   show_bus_name();
+   __atomic_store_n(&b->int_dirty, ~0u, __ATOMIC_RELEASE);
+   __atomic_store_n(&b->float_dirty, ~0u, __ATOMIC_RELEASE);
+   __atomic_store_n(&b->aux_dirty, ~0u, __ATOMIC_RELEASE);
+   __atomic_store_n(&b->switch_dirty, ~0u, __ATOMIC_RELEASE);
+   __atomic_store_n(&b->misc_dirty, ~0u, __ATOMIC_RELEASE);
+   __atomic_store_n(&b->extrema_dirty, ~0u, __ATOMIC_RELEASE);
+}
+
+// repaint at a fixed rate, however fast frames come in
+static void *render_thread(void *arg)
+{
+   struct timespec due;
+   long period = 1000000000L / render_hz;
+
+   (void) arg;
+   clock_gettime(CLOCK_MONOTONIC, &due);
+   while (rendering) {
+      switch (getch()) {
+      case 'n':
+	 if (nbuses > 1)
+	    show_bus((shown + 1) % nbuses);
+	 break;
+      case 'r':
+	 __atomic_store_n(&buses[shown]->trip_reset, 1, __ATOMIC_RELAXED);
+	 break;
+      }
+      render(buses[shown]);
+      due.tv_nsec += period;
+      while (due.tv_nsec >= 1000000000L) {
+	 due.tv_sec++;
+	 due.tv_nsec -= 1000000000L;
+      }
+      clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL);
+   }
+   return NULL;
+}
+
+static void render_start(void)
+{
+   // keys are polled by the render thread
+   nodelay(stdscr, TRUE);
+   show_bus_name();
+   rendering = 1;
+   if (start_thread(&render_tid, render_thread, NULL) != 0) {
+      endwin();
+      fprintf(stderr, "cannot start render thread\n");
+      exit(1);
+   }
+}
+
+// stop the render thread and bring the screen up to date
+static void render_stop(void)
+{
+   if (!rendering)
+      return;
+   rendering = 0;
+   pthread_join(render_tid, NULL);
+   nodelay(stdscr, FALSE);
+   render(buses[shown]);
+}
+
+// init ncurses
+static int ncurses_init(int null_term)
+{
+   FILE *null;
+
+   // init ncurses
+   if (null_term) {
+      // for benchmarks, a big enough terminal nobody looks at
+      null = fopen("/dev/null", "w");
+      if (null == NULL) {
+	 perror("/dev/null");
+	 return 1;
+      }
+      setenv("LINES", "50", 1);
+      setenv("COLUMNS", "120", 1);
+      if (newterm("xterm", null, stdin) == NULL) {
+	 fprintf(stderr, "cannot set up a null terminal\n");
+	 return 1;
+      }
+   } else
+      initscr();
+   //pass C- on, keep the rest
+   cbreak(); //raw();
+   // do sth to F-keys
+   keypad(stdscr, TRUE);
+   // turn of echoing to screen
+   noecho();
+
+   if(has_colors() == FALSE)
+   {
+      endwin();
+      printf("Your terminal does not support colour -- we want colour...\n");
+      return 1;
+   }
+   // enable colour
+   start_color();
+   init_pair(HEADING, COLOR_BLACK, COLOR_CYAN);
+   init_pair(WARN, COLOR_RED, COLOR_BLACK);
+   init_pair(HIL, COLOR_GREEN, COLOR_BLACK);
+
+   // get screen dimensions
+   getmaxyx(stdscr,row,col);
+   if (row < LINES || col < WIDTH)
+   {
+      endwin();
+      printf("Sorry, your terminal is too small to fit all data.\nCurrent size is %2dx%2d\nMinimum size is %2dx%2d\n",row,col,LINES,WIDTH);
+      return 1;
+   }
+
+   // paint initial screen w/o values
+   paint_empty_scr();
+
+   return 0;
+}
+
+// init ncurses screen and fill in some text
+static int paint_empty_scr(void)
+{
+   int i = 1;
+   for(i=1; i<=row; i++)
+   {
+      move(i, 1);
+      clrtoeol();
+   }
+   //attron(A_BOLD | A_REVERSE | COLOR_PAIR(2));
+   mvprintw(0, 0, " SCOOBY-DOO CAN VIEWER                                ");
+   //attroff(A_BOLD | A_REVERSE | COLOR_PAIR(2));
+   mvchgat(0, 0, -1, A_BOLD, 1, NULL);
+   mvprintw(STEER_LINE, 1, "steering value:");
+   mvprintw(STEER_LINE+1, 1, "steering angle degrees (LEFT -angle..angle RIGHT):");
+   mvprintw(AVG_SPEED_LINE, 1, "avg front wheel speed:");
+   mvprintw(AVG_SPEED_LINE, col-5-7, "msg cnt");
+   mvprintw(IND_SPEED_LINE, 1, "front wheel speeds:");
+   mvprintw(IND_SPEED_LINE+2, 1, "rear wheel speeds:");
+   mvprintw(TEMP_LINE, 1, "ambient temperature:      degC");
+   mvprintw(TEMP_LINE, col-5-7, "msg cnt");
+   mvprintw(FUEL_LINE, 1, "fuel consumption:");
+   mvprintw(TEMP_LINE, COOL_COL-20, "coolant temperature:");
+   mvprintw(FUEL_LINE, col-5-7, "msg cnt");
+   mvprintw(ENGINE_LINE, 1, "engine:");
+   mvprintw(ENGINE_LINE, ACCEL_COL-11, "accel ped:");
+   mvprintw(TORQUE_LINE, 1, "torques:");
+   mvprintw(TORQUE_LINE, RPM_COL, "  transm   engine     loss");
+   mvprintw(ACCEL_LINE, 1, "acceleration data:");
+   mvprintw(MINMAX_LINE, 1, "extrema:");
+   mvprintw(TRIP_LINE, 1, "since start:");
+   mvprintw(TRIP_LINE+1, 1, "trip (r resets):");
+
+   refresh();
+   return 0;
+}
+
+// the sinks, see struct sink
+static int tui_open(int bench)
+{
+   return ncurses_init(bench);
+}
+
+static void tui_stop(const char *why)
+{
+   static int closed;
+
+   render_stop();
+   if (closed)
+      return;
+   closed = 1;
+   if (why != NULL) {
+      mvprintw(row - 2, 1, "%s, press any key", why);
+      refresh();
+      getch();
+   }
+   endwin();
+}
+
+static int dump_open(int bench)
+{
+   // the dump output still gets formatted, it just goes nowhere
+   if (bench && freopen("/dev/null", "w", stdout) == NULL) {
+      perror("/dev/null");
+      return 1;
+   }
+   return 0;
+}
+
+static void dump_stop(const char *why)
+{
+   (void) why;
+   dump_flush();
+}
+
+static int sink_open(int bench)
+{
+   (void) bench;
+   return 0;
+}
+
+static void sink_start(void)
+{
+}
+
+static void sink_stop(const char *why)
+{
+   (void) why;
+}
+
+static void line_columns(struct bus *b, uint64_t now, const struct timeval *stamp)
+{
+   (void) now;
+   print_columns(nbuses > 1 ? b->name : NULL, stamp, b->int_mem, b->float_mem, b->switches);
+}
+
+static void line_window(struct bus *b, uint64_t now, const struct timeval *stamp)
+{
+   (void) now;
+   print_window(b, dump_window, stamp);
+}
+
+static void line_record(struct bus *b, uint64_t now, const struct timeval *stamp)
+{
+   (void) stamp;
+   record_one(b, now);
+}
+
+// the screen paints them itself
+static void line_none(struct bus *b, uint64_t now, const struct timeval *stamp)
+{
+   (void) b;
+   (void) now;
+   (void) stamp;
+}
+
+static void tpms_none(struct bus *b, uint64_t now, int wheel)
+{
+   (void) b;
+   (void) now;
+   (void) wheel;
+}
+
+static void tpms_print(struct bus *b, uint64_t now, int wheel);
+
+static const struct sink sinks[SINKS] = {
+   { "tui",    1, tui_open,  render_start, tui_stop,  line_none,    tpms_none },
+   { "dump",   0, dump_open, sink_start,   dump_stop, line_columns, tpms_print },
+   { "record", 0, sink_open, sink_start,   sink_stop, line_record,  tpms_print },
+   { "null",   0, sink_open, sink_start,   sink_stop, line_none,    tpms_print },
+};
+
+// TPMS - tire pressure monitoring system :-)
+// a wheel low on pressure has a smaller radius and turns faster than the
+// others, so we average each wheel's speed relative to the mean of all four
+// while driving straight and steady, and warn once a wheel stayed fast for
+// long enough
+static const char *tpms_wheels[4] = { "front left", "front right", "rear left", "rear right" };
+
+// without a screen the news goes to stderr
+static void tpms_print(struct bus *b, uint64_t now, int wheel)
+{
+   fprintf(stderr, "%010ld.%06ld %s tpms: %s %s (%+.2f%%)\n",
+	 (long) (now / 1000000), (long) (now % 1000000), b->name,
+	 tpms_wheels[wheel], b->tpms.low[wheel] ? "low" : "ok",
+	 b->tpms.ratio[wheel] * 100.);
+}
+
+// one judged sample, r are the wheel speeds relative to the mean, dt the
+// time since the previous sample
+static void tpms_step(struct bus *b, uint64_t now, double dt, const float *r)
+{
+   struct tpms *t = &b->tpms;
+   float alpha;
+   int i, low;
+
+   t->judged += dt;
+   alpha = dt < tpms_cfg.tau ? dt / tpms_cfg.tau : 1.;
+   for (i = 0; i < 4; i++) {
+      t->ratio[i] += alpha * (r[i] - t->ratio[i]);
+      if (t->ratio[i] > tpms_cfg.warn_ratio)
+	 t->suspect[i] += dt;
+      else if (t->ratio[i] < tpms_cfg.warn_ratio / 2. && (t->suspect[i] -= dt) < 0.)
+	 t->suspect[i] = 0.;
+
+      low = t->low[i] ? t->suspect[i] > 0. : t->suspect[i] >= tpms_cfg.warn_time;
+      if (low != t->low[i]) {
+	 t->low[i] = low;
+	 t->events++;
+	 set_misc(b, TPMS_FLAGS);
+	 if (!b->quiet)
+	    sink->tpms(b, now, i);
+      }
+   }
+}
+
+static void tpms_update(struct bus *b, uint64_t now)
+{
+   struct tpms *t = &b->tpms;
+   struct tpms_sample *s;
+   const float *v = &b->float_mem[SPEED_F_L];
+   float mean, r[4];
+   double dt;
+   int i, first;
+
+   dt = (now - t->last_us) * 1.e-6;
+   if (t->last_us == 0 || now <= t->last_us || now - t->last_us >= TRIP_MAX_GAP_US) {
+      // the previous chunk of an analysis may have the sample before
+      first = t->last_us == 0;
+      t->last_us = now;
+      if (!first || !t->collect)
+	 return;
+      dt = -1.;
+   }
+   t->last_us = now;
+
+   mean = (v[0] + v[1] + v[2] + v[3]) / 4.;
+   if (mean < tpms_cfg.min_speed || abs(b->int_mem[STEER_ANGLE]) > tpms_cfg.steer_limit ||
+	 fabsf(b->float_mem[A_X]) > tpms_cfg.accel_limit)
+      return;
+   for (i = 0; i < 4; i++)
+      r[i] = v[i] / mean - 1.;
+
+   if (!t->collect) {
+      tpms_step(b, now, dt, r);
+      return;
+   }
+   if (t->nsamples == t->maxsamples) {
+      t->maxsamples = t->maxsamples ? 2 * t->maxsamples : 4096;
+      t->samples = realloc(t->samples, t->maxsamples * sizeof(*t->samples));
+      if (t->samples == NULL) {
+	 perror("realloc");
+	 exit(1);
+      }
+   }
+   s = &t->samples[t->nsamples++];
+   s->us = now;
+   s->dt = dt;
+   memcpy(s->r, r, sizeof(s->r));
+}
+
+// where the TPMS guess stands
+static void report_tpms(struct bus *b, FILE *out)
+{
+   int i;
+
+   fprintf(out, "tpms: %.0f s judged, %u changes,", b->tpms.judged, b->tpms.events);
+   for (i = 0; i < 4; i++)
+      fprintf(out, " %s %+.2f%%%s", tpms_wheels[i], b->tpms.ratio[i] * 100.,
+	    b->tpms.low[i] ? " LOW" : "");
+   fprintf(out, "\n");
+}
+
+// init the values of a bus
+static void mem_init(struct bus *b)
+{
+   int i;
+
+   b->display = 0;
+
+   // init b->switches
+   b->switches[BREAK_SW] = 1;
+   b->switches[CLUTCH_SW] = 1;
+   b->switches[DOOR_SW] =1;
+
+   // init values
+   for (i = 0; i < INT_COUNT; i++) {
+      b->int_mem[i] = 0;
+   }
+   // init float values
+   for (i = 0; i < FLOAT_COUNT; i++) {
+      b->float_mem[i] = 0.0;
+   }
+}
+
+// decoder state for a bus named after its interface
+static struct bus *bus_alloc(const char *name)
+{
+   struct bus *b;
+
+   b = calloc(1, sizeof(*b));
+   // the one past the known frames is for the unknown ones
+   if (b != NULL)
+      b->stats = calloc(decode_nframes + 1, sizeof(*b->stats));
+   if (b == NULL || b->stats == NULL) {
+      perror("calloc");
+      exit(1);
+   }
+   strncpy(b->name, name, sizeof(b->name) - 1);
+   b->sock = -1;
+   b->sample_sock = -1;
+   mem_init(b);
+   return b;
+}
+
+static void bus_free(struct bus *b)
+{
+   int i;
+
+   for (i = 0; i < b->unknown_n; i++)
+      free(b->unknown_seen[i]->rev);
+   free(b->tpms.samples);
+   free(b->stats);
+   free(b);
+}
+
+// a new bus with its own decoder state
+static struct bus *bus_new(const char *name)
+{
+   if (nbuses == MAX_BUSES) {
+      fprintf(stderr, "no more than %d buses\n", MAX_BUSES);
+      exit(1);
+   }
+   buses[nbuses] = bus_alloc(name);
+   return buses[nbuses++];
+}
+
+// the index of the bus a log line belongs to by its interface name, -1 if
+// we do not decode that one
+static int bus_index(const char *name, int len)
+{
+   int i;
+
+   if (any_iface)
+      return 0;
+   for (i = 0; i < nbuses; i++)
+      if (strncmp(buses[i]->name, name, len) == 0 && buses[i]->name[len] == '\0')
+	 return i;
+   return -1;
+}
+
+// merging the state of a bus decoded in chunks, src is the chunk that
+// follows the ones merged into dst so far
+
+// the step from the last payload of dst to the first of src counts too
+static void rev_merge(struct unknown_id *u, const struct unknown_rev *src)
+{
+   struct unknown_rev *dst = u->rev;
+   uint64_t mask;
+   int j, k;
+
+   if (dst == NULL) {
+      u->rev = malloc(sizeof(*src));
+      if (u->rev != NULL)
+	 memcpy(u->rev, src, sizeof(*src));
+      return;
+   }
+   if (src->frames == 0)
+      return;
+   rev_flush(dst);
+   if (dst->frames) {
+      // only the bytes of the first payload of src, as in rev_frame()
+      mask = src->first_dlc >= CAN_MAX_DLEN ? ~0ull : (1ull << 8 * src->first_dlc) - 1;
+      rev_count(dst->toggle_planes, dst->last ^ src->first);
+      rev_count(dst->event_planes, rev_steps(dst->last, src->first) & mask);
+      dst->pending = 1;
+   } else {
+      dst->first = src->first;
+      dst->first_dlc = src->first_dlc;
+   }
+   rev_add(src->toggle_planes, dst->toggles);
+   rev_add(src->event_planes, dst->events);
+   for (j = 0; j < 64; j++) {
+      dst->toggles[j] += src->toggles[j];
+      dst->events[j] += src->events[j];
+   }
+   for (j = 0; j < CAN_MAX_DLEN; j++)
+      for (k = 0; k < 4; k++)
+	 dst->values[j][k] |= src->values[j][k];
+   if (src->dlc > dst->dlc)
+      dst->dlc = src->dlc;
+   dst->last = src->last;
+   dst->frames += src->frames;
+   dst->xor_zero += src->xor_zero;
+   for (k = 0; k < REV_REFS; k++) {
+      dst->n[k] += src->n[k];
+      dst->sy[k] += src->sy[k];
+      dst->syy[k] += src->syy[k];
+      for (j = 0; j < REV_CANDIDATES; j++) {
+	 dst->sx[k][j] += src->sx[k][j];
+	 dst->sxx[k][j] += src->sxx[k][j];
+	 dst->sxy[k][j] += src->sxy[k][j];
+      }
+   }
+}
+
+// the gap between the chunks counts like any other
+static void stats_merge(struct bus *dst, const struct bus *src)
+{
+   struct frame_stats *d;
+   const struct frame_stats *s;
+   int i, h;
+
+   for (i = 0; i < decode_nframes; i++) {
+      d = &dst->stats[i];
+      s = &src->stats[i];
+      if (s->count == 0)
+	 continue;
+      if (d->count == 0) {
+	 *d = *s;
+	 continue;
+      }
+      timing_gap(d, s->first_us > d->last_us ? s->first_us - d->last_us : 0);
+      if (decode_frames[i].cnt_mask)
+	 counter_step(&decode_frames[i], d, s->cnt_first);
+      if (s->count > 1) {
+	 if (s->min_dt < d->min_dt)
+	    d->min_dt = s->min_dt;
+	 if (s->max_dt > d->max_dt)
+	    d->max_dt = s->max_dt;
+      }
+      d->sum_dt += s->sum_dt;
+      d->sum_dt2 += s->sum_dt2;
+      for (h = 0; h < HIST_BUCKETS; h++)
+	 d->hist[h] += s->hist[h];
+      d->cnt_lost += s->cnt_lost;
+      d->cnt_gaps += s->cnt_gaps;
+      d->cnt_dups += s->cnt_dups;
+      d->cnt_last = s->cnt_last;
+      d->unchanged += s->unchanged;
+      d->last_le = s->last_le;
+      d->last_dlc = s->last_dlc;
+      d->cached = s->cached;
+      d->last_us = s->last_us;
+      d->count += s->count;
+   }
+}
+
+// all time statistics combine by Chan et al., window buckets by epoch
+static void agg_merge(struct bus *dst, const struct bus *src)
+{
+   struct agg *d;
+   const struct agg *s;
+   struct agg_bucket *dk;
+   const struct agg_bucket *sk;
+   double delta;
+   uint64_t n;
+   int i, w, j;
+
+   for (i = 0; i < AGG_SLOTS; i++) {
+      d = &dst->agg[i];
+      s = &src->agg[i];
+      if (s->n == 0)
+	 continue;
+      if (d->n == 0) {
+	 *d = *s;
+	 continue;
+      }
+      if (s->min < d->min)
+	 d->min = s->min;
+      if (s->max > d->max)
+	 d->max = s->max;
+      n = d->n + s->n;
+      delta = s->mean - d->mean;
+      d->mean += delta * s->n / n;
+      d->m2 += s->m2 + delta * delta * d->n * s->n / n;
+      d->n = n;
+
+      for (w = 0; w < AGG_WINDOWS; w++) {
+	 for (j = 0; j < AGG_BUCKETS; j++) {
+	    dk = &d->win[w].bucket[j];
+	    sk = &s->win[w].bucket[j];
+	    if (sk->n == 0 || (dk->n != 0 && sk->epoch < dk->epoch))
+	       continue;
+	    if (dk->n == 0 || sk->epoch > dk->epoch) {
+	       *dk = *sk;
+	       continue;
+	    }
+	    if (sk->min < dk->min)
+	       dk->min = sk->min;
+	    if (sk->max > dk->max)
+	       dk->max = sk->max;
+	    dk->n += sk->n;
+	    dk->sum += sk->sum;
+	    dk->sum2 += sk->sum2;
+	 }
+	 if (s->win[w].end_us > d->win[w].end_us) {
+	    d->win[w].end_us = s->win[w].end_us;
+	    d->win[w].cur = s->win[w].cur;
+	 }
+      }
+   }
+}
+
+// the first sample of src integrates from the last one of dst
+static void trip_merge(struct bus *dst, const struct bus *src)
+{
+   double dt;
+   int i;
+
+   if (src->fuel_first_us != 0) {
+      if (dst->fuel_us != 0 && src->fuel_first_us > dst->fuel_us &&
+	    src->fuel_first_us - dst->fuel_us < TRIP_MAX_GAP_US) {
+	 dt = (src->fuel_first_us - dst->fuel_us) * 1.e-6;
+	 for (i = 0; i < TRIP_COUNT; i++) {
+	    dst->trip[i].fuel_l += (dst->fuel_lph + src->fuel_first_lph) / 2. * dt / 3600.;
+	    if (src->fuel_first_engine)
+	       dst->trip[i].engine_s += dt;
+	 }
+      }
+      if (dst->fuel_first_us == 0) {
+	 dst->fuel_first_us = src->fuel_first_us;
+	 dst->fuel_first_lph = src->fuel_first_lph;
+	 dst->fuel_first_engine = src->fuel_first_engine;
+      }
+      dst->fuel_us = src->fuel_us;
+      dst->fuel_lph = src->fuel_lph;
+   }
+   if (src->dist_first_us != 0) {
+      if (dst->dist_us != 0 && src->dist_first_us > dst->dist_us &&
+	    src->dist_first_us - dst->dist_us < TRIP_MAX_GAP_US) {
+	 dt = (src->dist_first_us - dst->dist_us) * 1.e-6;
+	 for (i = 0; i < TRIP_COUNT; i++) {
+	    dst->trip[i].dist_km += (dst->speed_kmh + src->dist_first_kmh) / 2. * dt / 3600.;
+	    if (src->dist_first_kmh > 0. || dst->speed_kmh > 0.)
+	       dst->trip[i].moving_s += dt;
+	 }
+      }
+      if (dst->dist_first_us == 0) {
+	 dst->dist_first_us = src->dist_first_us;
+	 dst->dist_first_kmh = src->dist_first_kmh;
+      }
+      dst->dist_us = src->dist_us;
+      dst->speed_kmh = src->speed_kmh;
+   }
+   for (i = 0; i < TRIP_COUNT; i++) {
+      dst->trip[i].fuel_l += src->trip[i].fuel_l;
+      dst->trip[i].dist_km += src->trip[i].dist_km;
+      dst->trip[i].engine_s += src->trip[i].engine_s;
+      dst->trip[i].moving_s += src->trip[i].moving_s;
+   }
+}
+
+// the estimator runs over the samples of src, the first one only if it
+// follows the last sample of dst closely enough
+static void tpms_merge(struct bus *dst, const struct bus *src)
+{
+   const struct tpms_sample *p;
+   uint64_t last = dst->tpms.last_us;
+   size_t i;
+
+   for (i = 0; i < src->tpms.nsamples; i++) {
+      p = &src->tpms.samples[i];
+      if (p->dt >= 0.)
+	 tpms_step(dst, p->us, p->dt, p->r);
+      else if (last != 0 && p->us > last && p->us - last < TRIP_MAX_GAP_US)
+	 tpms_step(dst, p->us, (p->us - last) * 1.e-6, p->r);
+   }
+   if (src->tpms.last_us != 0)
+      dst->tpms.last_us = src->tpms.last_us;
+}
+
+static void bus_merge(struct bus *dst, const struct bus *src)
+{
+   struct unknown_id *u;
+   const struct unknown_id *s;
+   int i;
+
+   stats_merge(dst, src);
+   agg_merge(dst, src);
+   trip_merge(dst, src);
+   tpms_merge(dst, src);
+
+   // unknown IDs in order of appearance, the latest payload wins
+   for (i = 0; i < src->unknown_n; i++) {
+      s = src->unknown_seen[i];
+      u = unknown_entry(dst, s->id, s->first_us);
+      if (u == NULL) {
+	 dst->unknown_ext_lost += s->count;
+	 continue;
+      }
+      u->count += s->count;
+      u->last_us = s->last_us;
+      u->dlc = s->dlc;
+      memcpy(u->data, s->data, CAN_MAX_DLEN);
+      if (s->rev != NULL)
+	 rev_merge(u, s->rev);
+   }
+   dst->unknown_ext_lost += src->unknown_ext_lost;
+
+   // a switch that differs across the boundary changed there
+   for (i = 0; i < SWITCH_COUNT; i++) {
+      if (!(src->switch_seen & 1u << i))
+	 continue;
+      if (!(dst->switch_seen & 1u << i)) {
+	 dst->switch_seen |= 1u << i;
+	 dst->switch_first[i] = src->switch_first[i];
+      } else if (dst->switches[i] != src->switch_first[i])
+	 dst->switch_toggles[i]++;
+      dst->switch_toggles[i] += src->switch_toggles[i];
+      dst->switches[i] = src->switches[i];
+   }
+
+   // the latest values, of those src decoded at all
+   for (i = 0; i < INT_COUNT; i++)
+      if (src->agg[i].n)
+	 dst->int_mem[i] = src->int_mem[i];
+   for (i = 0; i < FLOAT_COUNT; i++)
+      if (src->agg[INT_COUNT + i].n)
+	 dst->float_mem[i] = src->float_mem[i];
+   for (i = 0; i < AUX_COUNT; i++)
+      if (src->aux_dirty & 1u << i)
+	 dst->aux_mem[i] = src->aux_mem[i];
+   dst->int_known |= src->int_known;
+   dst->float_known |= src->float_known;
+   dst->int_dirty |= src->int_dirty;
+   dst->float_dirty |= src->float_dirty;
+   dst->aux_dirty |= src->aux_dirty;
+   dst->switch_dirty |= src->switch_dirty;
+   dst->misc_dirty |= src->misc_dirty;
+   dst->extrema_dirty |= src->extrema_dirty;
+
+   dst->frames += src->frames;
+   if (src->last_frame_us > dst->last_frame_us)
+      dst->last_frame_us = src->last_frame_us;
+}
+
+// open a raw CAN socket on ifname with kernel timestamps enabled
+static int can_open(const char *ifname)
+{
+   int sock, recv_own_msgs, timestamp;
+   struct sockaddr_can addr;
+   struct ifreq ifr;
+
+   sock = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+   if (sock < 0) {
+      perror("socket");
+      exit(1);
+   }
+
+   memset(&ifr.ifr_name, 0, sizeof(ifr.ifr_name));
+   strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+   if (ioctl(sock, SIOCGIFINDEX, &ifr) < 0) {
+      perror("SIOCGIFINDEX");
+      exit(1);
+   }
+
+   memset(&addr, 0, sizeof(addr));
+   addr.can_family = AF_CAN;
+   addr.can_ifindex = ifr.ifr_ifindex;
+   if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+      perror("bind");
+      exit(1);
+   }
+
+   recv_own_msgs = 0; /* 0 = disabled (default), 1 = enabled */
+   setsockopt(sock, SOL_CAN_RAW, CAN_RAW_RECV_OWN_MSGS,
+	 &recv_own_msgs, sizeof(recv_own_msgs));
+
+   // have the kernel stamp each frame on arrival
+   timestamp = 1;
+   if (setsockopt(sock, SOL_SOCKET, SO_TIMESTAMP,
+	    &timestamp, sizeof(timestamp)) < 0)
+      perror("SO_TIMESTAMP");
+   // and tell us how many frames it dropped on a full queue
+   if (setsockopt(sock, SOL_SOCKET, SO_RXQ_OVFL,
+	    &timestamp, sizeof(timestamp)) < 0)
+      perror("SO_RXQ_OVFL");
+
+   return sock;
+}
+
+// have the kernel pass only the frames in our decode plan, or with invert
+// set only the others
+// returns 0 if the filter is in place
+static int can_filter_known(int sock, int invert)
+{
+   static struct can_filter filter[CAN_RAW_FILTER_MAX];
+   int i, join = 1;
+
+   if (decode_nframes > CAN_RAW_FILTER_MAX) {
+      fprintf(stderr, "%d known IDs, more than the kernel filters for us\n",
+	    decode_nframes);
+      return 1;
+   }
+   for (i = 0; i < decode_nframes; i++) {
+      filter[i].can_id = decode_frames[i].id;
+      // standard data frames with exactly this ID
+      filter[i].can_mask = CAN_SFF_MASK | CAN_EFF_FLAG | CAN_RTR_FLAG;
+      if (invert)
+	 filter[i].can_id |= CAN_INV_FILTER;
+   }
+   // inverted filters only make sense if a frame has to pass all of them
+   if (invert && setsockopt(sock, SOL_CAN_RAW, CAN_RAW_JOIN_FILTERS,
+	    &join, sizeof(join)) < 0) {
+      perror("CAN_RAW_JOIN_FILTERS");
+      return 1;
+   }
+   if (setsockopt(sock, SOL_CAN_RAW, CAN_RAW_FILTER,
+	    filter, decode_nframes * sizeof(filter[0])) < 0) {
+      perror("CAN_RAW_FILTER");
+      return 1;
+   }
+   return 0;
+}
+
+// open the sockets of bus b on the interface it is named after
+static int net_init(struct bus *b)
+{
+   int rcvbuf;
+
+   b->sock = can_open(b->name);
+   if (!known_only)
+      return 0;
+
+   // known-only: the kernel drops what we cannot decode ...
+   if (can_filter_known(b->sock, 0)) {
+      fprintf(stderr, "%s: receiving all frames\n", b->name);
+      return 0;
+   }
+   // ... and a second socket with a small queue sees only the rest, we
+   // drain it every now and then to keep discovering unknown IDs
+   b->sample_sock = can_open(b->name);
+   rcvbuf = UNKNOWN_SAMPLE_RCVBUF;
+   setsockopt(b->sample_sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+   if (can_filter_known(b->sample_sock, 1))
+      fprintf(stderr, "%s: sampling all frames for unknown IDs\n", b->name);
+
+   return 0;
+}
+
+// pull up to recv_batch frames from sock with a single syscall into
+// recv_frames, with the kernel receive timestamp of each in recv_stamps and
+// the drop count of the socket in *drops unless that is NULL
+// returns number of frames, 0 if interrupted or nothing is there
+static int recv_batch_from(int sock, int flags, uint32_t *drops)
+{
+   struct cmsghdr *cmsg;
+   int i, n, ret, have_stamp;
+
+   for (i = 0; i < recv_batch; i++) {
+      recv_iov[i].iov_base = &recv_frames[i];
+      recv_iov[i].iov_len = sizeof(struct can_frame);
+      recv_msgs[i].msg_hdr.msg_name = NULL;
+      recv_msgs[i].msg_hdr.msg_namelen = 0;
+      recv_msgs[i].msg_hdr.msg_iov = &recv_iov[i];
+      recv_msgs[i].msg_hdr.msg_iovlen = 1;
+      recv_msgs[i].msg_hdr.msg_control = recv_cmsg[i];
+      recv_msgs[i].msg_hdr.msg_controllen = sizeof(recv_cmsg[i]);
+      recv_msgs[i].msg_hdr.msg_flags = 0;
+   }
+
+   ret = recvmmsg(sock, recv_msgs, recv_batch, flags, NULL);
+   if (ret < 0) {
+      if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)
+	 return 0;
+      perror("recvmmsg");
+      exit(1);
+   }
+   recv_calls++;
+   recv_count += ret;
+
+   for (i = n = 0; i < ret; i++) {
+      if (recv_msgs[i].msg_len < sizeof(struct can_frame))
+	 continue;
+      have_stamp = 0;
+      for (cmsg = CMSG_FIRSTHDR(&recv_msgs[i].msg_hdr); cmsg != NULL;
+	    cmsg = CMSG_NXTHDR(&recv_msgs[i].msg_hdr, cmsg)) {
+	 if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_TIMESTAMP) {
+	    memcpy(&recv_stamps[n], CMSG_DATA(cmsg), sizeof(recv_stamps[n]));
+	    have_stamp = 1;
+	 } else if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL &&
+	       drops != NULL)
+	    memcpy(drops, CMSG_DATA(cmsg), sizeof(*drops));
+      }
+      if (!have_stamp) {
+	 // should not happen, but better late than never
+	 gettimeofday(&recv_stamps[n], NULL);
+	 recv_nostamp++;
+      }
+      if (n != i)
+	 recv_frames[n] = recv_frames[i];
+      n++;
+   }
+
+   return n;
+}
+
+// wake the decoder if it sleeps in ring_wait()
+static void ring_wake(void)
+{
+   if (__atomic_load_n(&ring.waiting, __ATOMIC_SEQ_CST) &&
+	 __atomic_exchange_n(&ring.waiting, 0, __ATOMIC_SEQ_CST))
+      syscall(SYS_futex, &ring.waiting, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+// queue n frames from recv_frames for the decoder, frames that do not fit
+// are lost and counted
+static void ring_push(struct bus *b, int n, int sampled)
+{
+   struct ring_slot *slot;
+   uint32_t head = ring.head;
+   uint32_t fill;
+   int i;
+
+   fill = head - __atomic_load_n(&ring.tail, __ATOMIC_ACQUIRE);
+   for (i = 0; i < n; i++) {
+      if (fill == RING_SIZE) {
+	 ring.full += n - i;
+	 break;
+      }
+      slot = &ring.slot[head & (RING_SIZE - 1)];
+      slot->frm = recv_frames[i];
+      slot->stamp = recv_stamps[i];
+      slot->b = b;
+      slot->sampled = sampled;
+      head++;
+      fill++;
+   }
+   if (fill > ring.high_water)
+      ring.high_water = fill;
+
+   // publish, then wake the decoder if it went to sleep before seeing it
+   __atomic_store_n(&ring.head, head, __ATOMIC_SEQ_CST);
+   ring_wake();
+}
+
+// take at most one batch of what is queued on bus b
+static int receive_batch(struct bus *b)
+{
+   int n;
+#ifdef PROF
+   uint64_t t0 = prof_now();
+#endif
+
+   n = recv_batch_from(b->sock, MSG_DONTWAIT, &b->kernel_drops);
+#ifdef PROF
+   if (n > 0)
+      prof_add(&prof[PROF_RECV], (prof_now() - t0) / n);
+#endif
+   if (n > 0)
+      ring_push(b, n, 0);
+
+   return n;
+}
+
+// in known-only mode, pass on what the sampling socket of b caught
+static void sample_unknown(struct bus *b)
+{
+   int i, j, n;
+
+   do {
+      n = recv_batch_from(b->sample_sock, MSG_DONTWAIT, NULL);
+      for (i = j = 0; i < n; i++)
+	 if ((recv_frames[i].can_id & CAN_EFF_FLAG) ||
+	       decode_index[recv_frames[i].can_id & CAN_SFF_MASK] == 0) {
+	    recv_frames[j] = recv_frames[i];
+	    recv_stamps[j++] = recv_stamps[i];
+	 }
+      if (j > 0)
+	 ring_push(b, j, 1);
+      recv_sampled += n;
+   } while (n == recv_batch);
+}
+
+// the receiver thread: wait for any bus and take a single batch from each
+// one that is ready, so a busy bus holds up the others for no more than
+// recv_batch frames
+static void *receive_thread(void *arg)
+{
+   struct epoll_event ev, events[MAX_BUSES + 1];
+   struct timespec now, last;
+   int i, n, epfd;
+
+   (void) arg;
+   epfd = epoll_create1(0);
+   if (epfd < 0) {
+      perror("epoll_create1");
+      exit(1);
+   }
+   for (i = 0; i < nbuses; i++) {
+      ev.events = EPOLLIN;
+      ev.data.ptr = buses[i];
+      if (epoll_ctl(epfd, EPOLL_CTL_ADD, buses[i]->sock, &ev) < 0) {
+	 perror("epoll_ctl");
+	 exit(1);
+      }
+   }
+   // receive_stop() tells us when to go
+   ev.events = EPOLLIN;
+   ev.data.ptr = NULL;
+   if (epoll_ctl(epfd, EPOLL_CTL_ADD, receive_stop_fd, &ev) < 0) {
+      perror("epoll_ctl");
+      exit(1);
+   }
+
+   clock_gettime(CLOCK_MONOTONIC, &last);
+   for (;;) {
+      // in known-only mode wake up regularly even if no known frames arrive
+      n = epoll_wait(epfd, events, MAX_BUSES + 1,
+	    known_only ? UNKNOWN_SAMPLE_US / 1000 : -1);
+      if (n < 0) {
+	 if (errno == EINTR)
+	    continue;
+	 perror("epoll_wait");
+	 exit(1);
+      }
+      // sockets stay ready as long as there is more, epoll hands them out
+      // round robin
+      for (i = 0; i < n; i++) {
+	 if (events[i].data.ptr == NULL) {
+	    close(epfd);
+	    return NULL;
+	 }
+	 receive_batch(events[i].data.ptr);
+      }
+
+      if (!known_only)
+	 continue;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      if ((now.tv_sec - last.tv_sec) * 1000000 + (now.tv_nsec - last.tv_nsec) / 1000
+	    < UNKNOWN_SAMPLE_US)
+	 continue;
+      last = now;
+      for (i = 0; i < nbuses; i++)
+	 if (buses[i]->sample_sock >= 0)
+	    sample_unknown(buses[i]);
+   }
+}
+
+static void receive_start(void)
+{
+   receive_stop_fd = eventfd(0, 0);
+   if (receive_stop_fd < 0) {
+      perror("eventfd");
+      exit(1);
+   }
+   if (start_thread(&receive_tid, receive_thread, NULL) != 0) {
+      fprintf(stderr, "cannot start receiver thread\n");
+      exit(1);
+   }
+}
+
+static void receive_stop(void)
+{
+   uint64_t one = 1;
+
+   if (write(receive_stop_fd, &one, sizeof(one)) != sizeof(one))
+      perror("eventfd");
+   pthread_join(receive_tid, NULL);
+   close(receive_stop_fd);
+}
+
+// decode what the receiver queued, a chunk at a time so it gets the slots
+// back early
+// returns the number of frames
+static int ring_decode(void)
+{
+   struct ring_slot *slot;
+   uint32_t head, tail = ring.tail;
+   int n;
+
+   head = __atomic_load_n(&ring.head, __ATOMIC_ACQUIRE);
+   if (head - tail > RING_SIZE / 8)
+      head = tail + RING_SIZE / 8;
+   n = head - tail;
+   for (; tail != head; tail++) {
+      slot = &ring.slot[tail & (RING_SIZE - 1)];
+      if (slot->sampled)
+	 unknown_frame(slot->b, &slot->frm, stamp_us(&slot->stamp));
+      else {
+	 process_one(slot->b, &slot->frm, &slot->stamp);
+	 if (player != NULL)
+	    play_match(slot);
+      }
+   }
+   __atomic_store_n(&ring.tail, tail, __ATOMIC_RELEASE);
+   return n;
+}
+
+// sleep until the receiver queues something, a signal comes in or the
+// player is done (it clears running, then wakes us)
+static void ring_wait(void)
+{
+   __atomic_store_n(&ring.waiting, 1, __ATOMIC_SEQ_CST);
+   if (__atomic_load_n(&ring.head, __ATOMIC_SEQ_CST) == ring.tail &&
+	 __atomic_load_n(&running, __ATOMIC_SEQ_CST))
+      syscall(SYS_futex, &ring.waiting, FUTEX_WAIT_PRIVATE, 1, NULL, NULL, 0);
+   __atomic_store_n(&ring.waiting, 0, __ATOMIC_SEQ_CST);
+}
+
+// the decoder side, until we are told to stop and the ring is empty
+static void decode_loop(void)
+{
+   while (running) {
+      // out of work, a good time for the output to catch up
+      if (ring_decode() == 0) {
+	 dump_flush();
+	 ring_wait();
+      }
+#ifdef PROF
+      prof_poll();
+#endif
+   }
+   receive_stop();
+   while (ring_decode() > 0)
+      ;
+}
+
+// CPU time used by us so far, user and system
+static double cpu_seconds(void)
+{
+   struct rusage ru;
+
+   getrusage(RUSAGE_SELF, &ru);
+   return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+      (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1.e-6;
+}
+
+// how well batching worked and what each frame cost us
+static void print_recv_stats(void)
+{
+   double cpu = cpu_seconds();
+   int i;
+
+   fprintf(stderr, "received %lu frames in %lu syscalls, %.2f frames/syscall\n",
+	 recv_count, recv_calls, recv_calls ? (double) recv_count / recv_calls : 0.);
+   fprintf(stderr, "cpu %.3f s, %.0f ns/frame\n",
+	 cpu, recv_count ? cpu * 1.e9 / recv_count : 0.);
+   if (recv_nostamp)
+      fprintf(stderr, "%lu frames without kernel timestamp\n", recv_nostamp);
+   if (known_only)
+      fprintf(stderr, "%lu of them sampled for unknown IDs\n", recv_sampled);
+   fprintf(stderr, "ring high water %u of %d frames, %lu frames lost on a full ring\n",
+	 ring.high_water, RING_SIZE, ring.full);
+   for (i = 0; i < nbuses; i++)
+      if (buses[i]->kernel_drops)
+	 fprintf(stderr, "%s: kernel dropped %u frames\n", buses[i]->name,
+	       buses[i]->kernel_drops);
+}
+
+// all time and windowed statistics of every int and float slot, the
+// windows end at the latest frame
+static void report_aggregates(struct bus *b, FILE *out)
+{
+   struct agg_stats st;
+   int i, w;
+
+   fprintf(out, "signals:             n        min        max       mean         sd");
+   for (w = 0; w < AGG_WINDOWS; w++)
+      fprintf(out, " %6s mean", agg_window_names[w]);
+   fprintf(out, "\n");
+   for (i = 0; i < AGG_SLOTS; i++) {
+      agg_total(b, i, &st);
+      if (st.n == 0)
+	 continue;
+      fprintf(out, "  %-11s %9lu %10.3f %10.3f %10.3f %10.3f",
+	    i < INT_COUNT ? int_names[i] : float_names[i - INT_COUNT],
+	    (unsigned long) st.n, st.min, st.max, st.mean, st.sd);
+      for (w = 0; w < AGG_WINDOWS; w++) {
+	 agg_window(b, i, w, b->last_frame_us, &st);
+	 fprintf(out, " %11.3f", st.mean);
+      }
+      fprintf(out, "\n");
+   }
+}
+
+// distance, fuel and times of the trip counters
+static void report_trips(struct bus *b, FILE *out)
+{
+   const struct trip *t;
+   int i;
+
+   for (i = 0; i < TRIP_COUNT; i++) {
+      t = &b->trip[i];
+      fprintf(out, "%s: %.3f km, %.3f l", trip_names[i], t->dist_km, t->fuel_l);
+      if (t->dist_km >= 0.1)
+	 fprintf(out, ", %.2f l/100km", t->fuel_l / t->dist_km * 100.);
+      if (t->engine_s > 0.)
+	 fprintf(out, ", %.2f l/h", t->fuel_l / t->engine_s * 3600.);
+      if (t->moving_s > 0.)
+	 fprintf(out, ", %.1f km/h", t->dist_km / t->moving_s * 3600.);
+      fprintf(out, ", engine %.0f s, moving %.0f s\n", t->engine_s, t->moving_s);
+   }
+}
+
+static void report_switches(struct bus *b, FILE *out)
+{
+   int i;
+
+   fprintf(out, "switch changes:");
+   for (i = 0; i < SWITCH_COUNT; i++)
+      if (b->switch_seen & 1u << i)
+	 fprintf(out, " %s %u", switch_names[i], b->switch_toggles[i]);
+   fprintf(out, "\n");
+}
+
+// the end of session reports of all buses
+static void report_buses(FILE *out)
+{
+   int i;
+
+   for (i = 0; i < nbuses; i++) {
+      if (nbuses > 1)
+	 fprintf(out, "bus %s: %lu frames\n", buses[i]->name, buses[i]->frames);
+      report_timing(buses[i], out);
+      report_aggregates(buses[i], out);
+      report_trips(buses[i], out);
+      report_tpms(buses[i], out);
+      report_switches(buses[i], out);
+      report_unknown(buses[i], out);
+   }
+#ifdef PROF
+   prof_report(out);
+#endif
+}
+
+#ifdef PROF
+static void prof_print(FILE *out, const char *name, const char *unit,
+      const struct prof_hist *h)
+{
+   int i;
+
+   fprintf(out, "  %-10s %10lu  mean %10.1f %s\n       ", name, (unsigned long) h->n,
+	 (double) h->sum / h->n, unit);
+   for (i = 0; i < PROF_BUCKETS; i++)
+      if (h->hist[i])
+	 fprintf(out, " %s%lu:%u", i == PROF_BUCKETS - 1 ? ">=" : "", 1UL << i, h->hist[i]);
+   fprintf(out, "\n");
+}
+
+// where the time goes, all stages and the decoding of each ID
+static void prof_report(FILE *out)
+{
+   const struct frame_stats *st;
+   char name[16];
+   int i, j;
+
+   fprintf(out, "hot path:\n");
+   for (i = 0; i < PROF_STAGES; i++)
+      if (prof[i].n)
+	 prof_print(out, prof_names[i], prof_units[i], &prof[i]);
+   for (j = 0; j < nbuses; j++) {
+      fprintf(out, "decoding %s, ticks:\n", buses[j]->name);
+      for (i = 0; i <= decode_nframes; i++) {
+	 st = &buses[j]->stats[i];
+	 if (st->decode.n == 0)
+	    continue;
+	 if (i == decode_nframes)
+	    snprintf(name, sizeof(name), "unknown");
+	 else
+	    snprintf(name, sizeof(name), "%03x", decode_frames[i].id);
+	 prof_print(out, name, "ticks", &st->decode);
+      }
+   }
+}
+
+// SIGUSR1 asks for the report while we run
+static void prof_request(int sig)
+{
+   (void) sig;
+   prof_dump = 1;
+}
+
+static void prof_poll(void)
+{
+   FILE *out;
+
+   if (!prof_dump)
+      return;
+   prof_dump = 0;
+   if (!sink->screen) {
+      prof_report(stderr);
+      return;
+   }
+   // not over the screen
+   out = fopen("ScoobyCAN.prof", "a");
+   if (out == NULL)
+      return;
+   prof_report(out);
+   fclose(out);
+}
+#endif
+
+static void stop_running(int sig)
+{
+   (void) sig;
+   running = 0;
+}
+
+// SIGUSR2 resets the trip counters of all buses
+static void reset_trips(int sig)
+{
+   int i;
+
+   (void) sig;
+   for (i = 0; i < nbuses; i++)
+      __atomic_store_n(&buses[i]->trip_reset, 1, __ATOMIC_RELAXED);
+}
+
+// value of a single hex digit, -1 if it is none
+static inline int hexval(char c)
+{
+   if (c >= '0' && c <= '9')
+      return c - '0';
+   if (c >= 'A' && c <= 'F')
+      return c - 'A' + 10;
+   if (c >= 'a' && c <= 'f')
+      return c - 'a' + 10;
+   return -1;
+}
+
+// parse one candump line '(1428331363.006173) slcan0 410#00001A1300CA0301'
+// and advance *pos to the start of the next line, the interface name goes
+// to *ifname and *iflen unless ifname is NULL
+// returns 0 for a frame, 1 for a line we skip (comments, FD, garbage), -1 at end
+static int parse_candump_scalar(const char **pos, const char *end,
+      struct can_frame *frm, struct timeval *stamp, const char **ifname, int *iflen)
+{
+   const char *p = *pos;
+   const char *eol, *name;
+   long sec, usec;
+   int digits, d, h, l;
+   canid_t id;
+
+   if (p >= end)
+      return -1;
+   eol = memchr(p, '\n', end - p);
+   if (eol == NULL)
+      eol = end;
+   *pos = eol + 1;
+
+   // timestamp
+   if (*p++ != '(')
+      return 1;
+   for (sec = 0; p < eol && (d = hexval(*p)) >= 0 && d < 10; p++)
+      sec = sec*10 + d;
+   if (p >= eol || *p++ != '.')
+      return 1;
+   for (usec = 0, digits = 0; p < eol && (d = hexval(*p)) >= 0 && d < 10; p++, digits++)
+      usec = usec*10 + d;
+   for (; digits < 6; digits++)
+      usec *= 10;
+   if (p >= eol || *p++ != ')')
+      return 1;
+
+   // interface name
+   while (p < eol && *p == ' ')
+      p++;
+   name = p;
+   while (p < eol && *p != ' ')
+      p++;
+   if (ifname != NULL) {
+      *ifname = name;
+      *iflen = p - name;
+   }
+   while (p < eol && *p == ' ')
+      p++;
+
+   // ID, 3 digits for standard and 8 for extended frames
+   for (id = 0, digits = 0; p < eol && (d = hexval(*p)) >= 0; p++, digits++)
+      id = (id << 4) | d;
+   if (p >= eol || *p++ != '#' || (digits != 3 && digits != 8))
+      return 1;
+   if (digits == 8)
+      id |= CAN_EFF_FLAG;
+
+   memset(frm, 0, sizeof(*frm));
+   if (p < eol && (*p == 'R' || *p == 'r')) {
+      // remote request, no payload
+      frm->can_id = id | CAN_RTR_FLAG;
+      frm->can_dlc = 0;
+   } else {
+      frm->can_id = id;
+      while (p + 1 < eol && frm->can_dlc < CAN_MAX_DLEN) {
+	 if (*p == '.')
+	    p++;
+	 if ((h = hexval(p[0])) < 0 || (l = hexval(p[1])) < 0)
+	    break;
+	 frm->data[frm->can_dlc++] = (h << 4) | l;
+	 p += 2;
+      }
+      // CAN FD ('##') or trailing garbage
+      if (p < eol && *p != '\r' && *p != ' ')
+	 return 1;
+   }
+
+   stamp->tv_sec = sec;
+   stamp->tv_usec = usec;
+   return 0;
+}
+
+#ifdef __SSE2__
+// mask of the decimal digits in v
+static inline unsigned int digit_mask(__m128i v)
+{
+   __m128i d = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+
+   return _mm_movemask_epi8(_mm_and_si128(_mm_cmpgt_epi8(d, _mm_set1_epi8(-1)),
+	    _mm_cmplt_epi8(d, _mm_set1_epi8(10))));
+}
+
+// the hex digits of v as nibbles in *nib, other bytes 0, returns the mask
+// of the hex digits
+static inline unsigned int hex_nibbles(__m128i v, __m128i *nib)
+{
+   __m128i dig, alpha, isdig, isalpha;
+
+   dig = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+   isdig = _mm_and_si128(_mm_cmpgt_epi8(dig, _mm_set1_epi8(-1)),
+	 _mm_cmplt_epi8(dig, _mm_set1_epi8(10)));
+   // either case, 'a' to 'f' become 0 to 5
+   alpha = _mm_sub_epi8(_mm_or_si128(v, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+   isalpha = _mm_and_si128(_mm_cmpgt_epi8(alpha, _mm_set1_epi8(-1)),
+	 _mm_cmplt_epi8(alpha, _mm_set1_epi8(6)));
+   alpha = _mm_add_epi8(alpha, _mm_set1_epi8(10));
+   *nib = _mm_or_si128(_mm_and_si128(isdig, dig), _mm_and_si128(isalpha, alpha));
+   return _mm_movemask_epi8(_mm_or_si128(isdig, isalpha));
+}
+
+// 8 decimal digits, the first in the lowest byte, to their value
+static inline uint32_t digits8(uint64_t v)
+{
+   v -= 0x3030303030303030ull;
+   v = v * 10 + (v >> 8);
+   v = ((v & 0x000000ff000000ffull) * (100 + (1000000ull << 32)) +
+	 ((v >> 16) & 0x000000ff000000ffull) * (1 + (10000ull << 32))) >> 32;
+   return v;
+}
+
+// the line shape candump writes, '(SSSSSSSSSS.UUUUUU) NAME III#DD..' with a 3
+// or 8 digit ID and up to 8 payload bytes, with 16 byte loads instead of a
+// byte at a time; needs 64 bytes to read from
+// returns 0 for a frame, 1 for anything else, which is left to the scalar
+// parser
+static int parse_candump_fast(const char **pos, struct can_frame *frm,
+      struct timeval *stamp, const char **ifname, int *iflen)
+{
+   const char *p = *pos, *q;
+   uint8_t x[16];
+   __m128i nib, w;
+   uint64_t v;
+   unsigned int m, n, i, dlc;
+   canid_t id;
+
+   // timestamp, 10 and 6 digits
+   if (p[0] != '(' || p[11] != '.' || p[18] != ')' || p[19] != ' ' || p[20] == ' ')
+      return 1;
+   if ((digit_mask(_mm_loadu_si128((const __m128i *) (p + 1))) | 1u << 10) != 0xffff ||
+	 p[17] < '0' || p[17] > '9')
+      return 1;
+   memcpy(&v, p + 1, sizeof(v));
+   stamp->tv_sec = digits8(v) * 100L + (p[9] - '0') * 10 + (p[10] - '0');
+   // '0' over the last second digit and the '.'
+   memcpy(&v, p + 10, sizeof(v));
+   stamp->tv_usec = digits8((v & ~0xffffull) | 0x3030);
+
+   // interface name up to the first space, which has to be on this line
+   w = _mm_loadu_si128((const __m128i *) (p + 20));
+   m = _mm_movemask_epi8(_mm_cmpeq_epi8(w, _mm_set1_epi8(' ')));
+   if (m == 0 || (_mm_movemask_epi8(_mm_cmpeq_epi8(w, _mm_set1_epi8('\n'))) & ((m & -m) - 1)))
+      return 1;
+   n = __builtin_ctz(m);
+   if (ifname != NULL) {
+      *ifname = p + 20;
+      *iflen = n;
+   }
+   q = p + 21 + n;
+
+   // ID up to the '#'
+   m = hex_nibbles(_mm_loadu_si128((const __m128i *) q), &nib);
+   n = __builtin_ctz(~m);
+   if ((n != 3 && n != 8) || q[n] != '#')
+      return 1;
+   _mm_storeu_si128((__m128i *) x, nib);
+   for (id = 0, i = 0; i < n; i++)
+      id = (id << 4) | x[i];
+   if (n == 8)
+      id |= CAN_EFF_FLAG;
+   q += n + 1;
+
+   // payload, pairs of nibbles to bytes, then the end of the line
+   m = hex_nibbles(_mm_loadu_si128((const __m128i *) q), &nib);
+   n = __builtin_ctz(~m);
+   if (n & 1)
+      return 1;
+   dlc = n / 2;
+   if (q[n] == '\r')
+      n++;
+   if (q[n] != '\n')
+      return 1;
+   w = _mm_or_si128(_mm_slli_epi16(nib, 4), _mm_srli_epi16(nib, 8));
+   w = _mm_packus_epi16(_mm_and_si128(w, _mm_set1_epi16(0xff)), _mm_setzero_si128());
+   _mm_storel_epi64((__m128i *) &v, w);
+
+   memset(frm, 0, sizeof(*frm));
+   frm->can_id = id;
+   frm->can_dlc = dlc;
+   // bytes past the payload come from the next line
+   if (dlc < CAN_MAX_DLEN)
+      v &= (1ull << (dlc * 8)) - 1;
+   memcpy(frm->data, &v, sizeof(v));
+   *pos = q + n + 1;
+   return 0;
+}
+#endif
+
+// parse one candump line, see parse_candump_scalar(), most lines take the
+// fast path
+static int parse_candump(const char **pos, const char *end,
+      struct can_frame *frm, struct timeval *stamp, const char **ifname, int *iflen)
+{
+#ifdef __SSE2__
+   if (end - *pos >= 64 && parse_candump_fast(pos, frm, stamp, ifname, iflen) == 0)
+      return 0;
+#endif
+   return parse_candump_scalar(pos, end, frm, stamp, ifname, iflen);
+}
+
+// map a log file for reading, an empty one has *len 0 and nothing mapped
+static int log_map(const char *fname, const char **map, size_t *len)
+{
+   struct stat st;
+   int fd;
+
+   *map = NULL;
+   *len = 0;
+   fd = open(fname, O_RDONLY);
+   if (fd < 0) {
+      perror(fname);
+      return 1;
+   }
+   if (fstat(fd, &st) < 0) {
+      perror("fstat");
+      close(fd);
+      return 1;
+   }
+   if (st.st_size == 0) {
+      close(fd);
+      return 0;
+   }
+   *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if (*map == MAP_FAILED) {
+      perror("mmap");
+      return 1;
+   }
+   *len = st.st_size;
+   return 0;
+}
+
+// seekable logs: a sidecar LOG.idx has the offset of a line every
+// INDEX_INTERVAL_US of log time and the decoder state of every bus just
+// before it, so a replay can start anywhere after a binary search and a
+// few seconds of decoding
+#define INDEX_MAGIC "SCIX"
+#define INDEX_VERSION 2
+#define INDEX_INTERVAL_US 10000000ULL
+struct index_header {
+   char magic[4];
+   uint32_t version;
+   uint32_t state_size;    // sizeof(struct index_state)
+   uint32_t nbuses;
+   uint32_t any_iface;
+   uint32_t pad;
+   uint64_t decoder;       // fingerprint of the signal tables
+   uint64_t log_size;      // the log it was built from
+   int64_t log_mtime_ns;
+   uint64_t first_us;      // the first frame
+   uint64_t count;         // checkpoints
+   char names[MAX_BUSES][IFNAMSIZ];
+};
+// followed by count index_entry and count * nbuses index_state
+struct index_entry {
+   uint64_t stamp_us;
+   uint64_t offset;
+};
+struct index_state {
+   int32_t ints[INT_COUNT];
+   float floats[FLOAT_COUNT];
+   float aux[AUX_COUNT];
+   uint8_t switches[SWITCH_COUNT];
+   uint32_t int_known, float_known;
+   uint8_t tpms_low[4];
+   float tpms_ratio[4], tpms_suspect[4];
+   uint64_t tpms_last_us;
+   double tpms_judged;
+   uint32_t tpms_events;
+   uint32_t display;
+   struct trip trip[TRIP_COUNT];
+   uint64_t fuel_us, dist_us;
+   float fuel_lph, speed_kmh;
+};
+struct log_index {
+   const struct index_header *hdr;
+   const struct index_entry *entries;
+   const struct index_state *states;
+   char *buf;              // all of it
+};
+
+// FNV-1a over the decoder tables, an index only fits the decoder it was
+// built with
+static uint64_t decoder_fingerprint(void)
+{
+   const unsigned char *p;
+   uint64_t h = 14695981039346656037ull;
+   size_t i, n;
+   int j;
+
+   for (j = 0; j < decode_nframes; j++) {
+      const uint64_t f[] = { decode_frames[j].id, decode_frames[j].first,
+	 decode_frames[j].count, decode_frames[j].cnt_shift,
+	 decode_frames[j].cnt_flags, decode_frames[j].cnt_mask };
+
+      for (p = (const unsigned char *) f, i = 0; i < sizeof(f); i++)
+	 h = (h ^ p[i]) * 1099511628211ull;
+   }
+   n = decode_nsigs * sizeof(decode_sigs[0]);
+   for (p = (const unsigned char *) decode_sigs, i = 0; i < n; i++)
+      h = (h ^ p[i]) * 1099511628211ull;
+   // the TPMS state of the checkpoints depends on its settings, too
+   for (p = (const unsigned char *) &tpms_cfg, i = 0; i < sizeof(tpms_cfg); i++)
+      h = (h ^ p[i]) * 1099511628211ull;
+   return h;
+}
+
+// what the decoder needs to go on from a checkpoint
+static void state_save(const struct bus *b, struct index_state *s)
+{
+   memset(s, 0, sizeof(*s));
+   memcpy(s->ints, b->int_mem, sizeof(s->ints));
+   memcpy(s->floats, b->float_mem, sizeof(s->floats));
+   memcpy(s->aux, b->aux_mem, sizeof(s->aux));
+   memcpy(s->switches, b->switches, sizeof(s->switches));
+   s->int_known = b->int_known;
+   s->float_known = b->float_known;
+   memcpy(s->tpms_low, b->tpms.low, sizeof(s->tpms_low));
+   memcpy(s->tpms_ratio, b->tpms.ratio, sizeof(s->tpms_ratio));
+   memcpy(s->tpms_suspect, b->tpms.suspect, sizeof(s->tpms_suspect));
+   s->tpms_last_us = b->tpms.last_us;
+   s->tpms_judged = b->tpms.judged;
+   s->tpms_events = b->tpms.events;
+   s->display = b->display;
+   memcpy(s->trip, b->trip, sizeof(s->trip));
+   s->fuel_us = b->fuel_us;
+   s->dist_us = b->dist_us;
+   s->fuel_lph = b->fuel_lph;
+   s->speed_kmh = b->speed_kmh;
+}
+
+static void state_restore(struct bus *b, const struct index_state *s)
+{
+   int i;
+
+   memcpy(b->int_mem, s->ints, sizeof(s->ints));
+   memcpy(b->float_mem, s->floats, sizeof(s->floats));
+   memcpy(b->aux_mem, s->aux, sizeof(s->aux));
+   memcpy(b->switches, s->switches, sizeof(s->switches));
+   b->int_known = s->int_known;
+   b->float_known = s->float_known;
+   memcpy(b->tpms.low, s->tpms_low, sizeof(s->tpms_low));
+   memcpy(b->tpms.ratio, s->tpms_ratio, sizeof(s->tpms_ratio));
+   memcpy(b->tpms.suspect, s->tpms_suspect, sizeof(s->tpms_suspect));
+   b->tpms.last_us = s->tpms_last_us;
+   b->tpms.judged = s->tpms_judged;
+   b->tpms.events = s->tpms_events;
+   b->display = s->display;
+   memcpy(b->trip, s->trip, sizeof(s->trip));
+   b->fuel_us = s->fuel_us;
+   b->dist_us = s->dist_us;
+   b->fuel_lph = s->fuel_lph;
+   b->speed_kmh = s->speed_kmh;
+   __atomic_store_n(&b->int_dirty, ~0u, __ATOMIC_RELEASE);
+   __atomic_store_n(&b->float_dirty, ~0u, __ATOMIC_RELEASE);
+   __atomic_store_n(&b->switch_dirty, ~0u, __ATOMIC_RELEASE);
+   set_misc(b, TPMS_FLAGS);
+   set_misc(b, TRIP_DATA);
+   // the values no longer go with the payloads seen last
+   for (i = 0; i < decode_nframes; i++)
+      b->stats[i].cached = 0;
+}
+
+// forget the statistics so far, not the decoded state, nor the windows of
+// the aggregates, they only look back as far as they are long anyway
+static void bus_clear_stats(struct bus *b)
+{
+   int i;
+
+   for (i = 0; i < b->unknown_n; i++)
+      free(b->unknown_seen[i]->rev);
+   memset(b->stats, 0, (decode_nframes + 1) * sizeof(*b->stats));
+   for (i = 0; i < AGG_SLOTS; i++) {
+      b->agg[i].n = 0;
+      b->agg[i].min = b->agg[i].max = 0.;
+      b->agg[i].mean = b->agg[i].m2 = 0.;
+   }
+   memset(b->unknown_std, 0, sizeof(b->unknown_std));
+   memset(b->unknown_ext, 0, sizeof(b->unknown_ext));
+   b->unknown_n = 0;
+   b->unknown_ext_lost = 0;
+   b->switch_seen = 0;
+   memset(b->switch_toggles, 0, sizeof(b->switch_toggles));
+   b->frames = 0;
+}
+
+static void index_free(struct log_index *ix)
+{
+   free(ix->buf);
+   ix->buf = NULL;
+}
+
+// the index in fname if it is there and fits the log and the buses
+static int index_load(const char *fname, const struct stat *st, struct log_index *ix)
+{
+   const struct index_header *h;
+   const char *map;
+   size_t len;
+   int i;
+
+   if (access(fname, R_OK) != 0 || log_map(fname, &map, &len) || len < sizeof(*h))
+      return 1;
+   h = (const struct index_header *) map;
+   if (memcmp(h->magic, INDEX_MAGIC, sizeof(h->magic)) != 0 || h->version != INDEX_VERSION ||
+	 h->state_size != sizeof(struct index_state) || h->nbuses != (uint32_t) nbuses ||
+	 h->any_iface != (uint32_t) any_iface || h->decoder != decoder_fingerprint() ||
+	 h->log_size != (uint64_t) st->st_size ||
+	 h->log_mtime_ns != st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec ||
+	 len != sizeof(*h) + h->count * (sizeof(struct index_entry) +
+	    nbuses * sizeof(struct index_state))) {
+      munmap((void *) map, len);
+      return 1;
+   }
+   for (i = 0; i < nbuses; i++)
+      if (strncmp(h->names[i], buses[i]->name, IFNAMSIZ) != 0) {
+	 munmap((void *) map, len);
+	 return 1;
+      }
+   ix->buf = malloc(len);
+   if (ix->buf == NULL) {
+      perror("malloc");
+      exit(1);
+   }
+   memcpy(ix->buf, map, len);
+   munmap((void *) map, len);
+   ix->hdr = (const struct index_header *) ix->buf;
+   ix->entries = (const struct index_entry *) (ix->hdr + 1);
+   ix->states = (const struct index_state *) (ix->entries + ix->hdr->count);
+   return 0;
+}
+
+// decode the whole log once, a checkpoint every INDEX_INTERVAL_US
+static void index_build(const char *map, size_t len, const struct stat *st,
+      struct log_index *ix)
+{
+   struct index_header *h;
+   struct index_entry *e;
+   struct index_state *s;
+   struct bus *b[MAX_BUSES];
+   struct can_frame frm;
+   struct timeval stamp;
+   const char *pos = map, *line, *ifname;
+   uint64_t due = 0, now;
+   size_t count = 0, max = 0;
+   char *buf;
+   int ret, iflen, i, j;
+
+   for (i = 0; i < nbuses; i++) {
+      b[i] = bus_alloc(buses[i]->name);
+      b[i]->quiet = 1;
+   }
+   e = NULL;
+   s = NULL;
+   for (line = pos; (ret = parse_candump(&pos, map + len, &frm, &stamp, &ifname, &iflen)) >= 0;
+	 line = pos) {
+      if (ret > 0 || (j = bus_index(ifname, iflen)) < 0)
+	 continue;
+      now = stamp_us(&stamp);
+      if (now >= due) {
+	 if (count == max) {
+	    max = max ? 2 * max : 1024;
+	    e = realloc(e, max * sizeof(*e));
+	    s = realloc(s, max * nbuses * sizeof(*s));
+	    if (e == NULL || s == NULL) {
+	       perror("realloc");
+	       exit(1);
+	    }
+	 }
+	 e[count].stamp_us = now;
+	 e[count].offset = line - map;
+	 for (i = 0; i < nbuses; i++)
+	    state_save(b[i], &s[count * nbuses + i]);
+	 count++;
+	 due = now + INDEX_INTERVAL_US;
+      }
+      process_one(b[j], &frm, &stamp);
+   }
+   for (i = 0; i < nbuses; i++)
+      bus_free(b[i]);
+
+   // one buffer, laid out like the file
+   buf = calloc(1, sizeof(*h) + count * (sizeof(*e) + nbuses * sizeof(*s)));
+   if (buf == NULL) {
+      perror("calloc");
+      exit(1);
+   }
+   h = (struct index_header *) buf;
+   memcpy(h->magic, INDEX_MAGIC, sizeof(h->magic));
+   h->version = INDEX_VERSION;
+   h->state_size = sizeof(*s);
+   h->nbuses = nbuses;
+   h->any_iface = any_iface;
+   h->decoder = decoder_fingerprint();
+   h->log_size = st->st_size;
+   h->log_mtime_ns = st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec;
+   h->first_us = count ? e[0].stamp_us : 0;
+   h->count = count;
+   for (i = 0; i < nbuses; i++)
+      memcpy(h->names[i], buses[i]->name, IFNAMSIZ);
+   if (count) {
+      memcpy(h + 1, e, count * sizeof(*e));
+      memcpy(buf + sizeof(*h) + count * sizeof(*e), s, count * nbuses * sizeof(*s));
+   }
+   free(e);
+   free(s);
+   ix->buf = buf;
+   ix->hdr = h;
+   ix->entries = (const struct index_entry *) (h + 1);
+   ix->states = (const struct index_state *) (ix->entries + count);
+}
+
+// the index of a log, from LOG.idx or built and saved there
+static int index_get(const char *logname, const char *map, size_t len,
+      struct log_index *ix)
+{
+   char fname[PATH_MAX];
+   struct stat st;
+   size_t size;
+   FILE *f;
+   int ret;
+
+   if (stat(logname, &st) < 0) {
+      perror(logname);
+      return 1;
+   }
+   snprintf(fname, sizeof(fname), "%s.idx", logname);
+   if (index_load(fname, &st, ix) == 0)
+      return 0;
+
+   fprintf(stderr, "indexing %s\n", logname);
+   index_build(map, len, &st, ix);
+   size = sizeof(*ix->hdr) + ix->hdr->count * (sizeof(*ix->entries) +
+	 nbuses * sizeof(*ix->states));
+   // in a read only place we just index again next time
+   f = fopen(fname, "w");
+   if (f == NULL) {
+      perror(fname);
+      return 0;
+   }
+   ret = fwrite(ix->buf, size, 1, f) != 1;
+   if (fclose(f) != 0 || ret) {
+      perror(fname);
+      unlink(fname);
+   }
+   return 0;
+}
+
+// the last checkpoint at or before us, count if there is none
+static size_t index_find(const struct log_index *ix, uint64_t us)
+{
+   size_t lo = 0, hi = ix->hdr->count, mid;
+
+   // the first entry after us
+   while (lo < hi) {
+      mid = lo + (hi - lo) / 2;
+      if (ix->entries[mid].stamp_us <= us)
+	 lo = mid + 1;
+      else
+	 hi = mid;
+   }
+   return lo ? lo - 1 : ix->hdr->count;
+}
+
+// sleep until a frame stamped stamp is due at speed times real time, the
+// first frame was at start
+static void pace(const struct timespec *start, const struct timeval *first,
+      const struct timeval *stamp, double speed)
+{
+   struct timespec due;
+   double offset;
+
+   offset = ((stamp->tv_sec - first->tv_sec) +
+	 (stamp->tv_usec - first->tv_usec) * 1.e-6) / speed;
+   due.tv_sec = start->tv_sec + (time_t) offset;
+   due.tv_nsec = start->tv_nsec + (long) ((offset - (time_t) offset) * 1.e9);
+   if (due.tv_nsec >= 1000000000) {
+      due.tv_sec++;
+      due.tv_nsec -= 1000000000;
+   }
+   clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL);
+}
+
+// feed a candump log file to the decoder, either as fast as we can (speed <= 0)
+// or paced by the recorded timestamps at speed times real time; from and to
+// are seconds after the first frame, to <= 0 for the end
+static int replay_file(const char *fname, double speed, double from, double to)
+{
+   struct can_frame frm;
+   struct timeval stamp, first = { 0, 0 };
+   struct timespec start, now;
+   struct log_index ix;
+   struct bus *b;
+   const char *map, *pos, *end, *ifname;
+   unsigned long frames = 0, skipped = 0, other = 0;
+   uint64_t base_us = 0, from_us = 0, to_us = UINT64_MAX;
+   double elapsed;
+   size_t len, k;
+   int ret, iflen, i, seeking = 0;
+
+   if (log_map(fname, &map, &len))
+      return 1;
+   if (len == 0)
+      return 0;
+   madvise((void *)map, len, MADV_SEQUENTIAL);
+
+   pos = map;
+   end = map + len;
+   if (from > 0.) {
+      // continue from the last checkpoint before from, quietly up to it
+      if (index_get(fname, map, len, &ix)) {
+	 munmap((void *)map, len);
+	 return 1;
+      }
+      base_us = ix.hdr->first_us;
+      from_us = base_us + (uint64_t) (from * 1.e6);
+      // far enough back for the longest window to fill up before from
+      k = index_find(&ix, from_us - base_us > agg_window_us[AGG_WINDOWS - 1] ?
+	    from_us - agg_window_us[AGG_WINDOWS - 1] : base_us);
+      if (k < ix.hdr->count) {
+	 pos = map + ix.entries[k].offset;
+	 for (i = 0; i < nbuses; i++) {
+	    state_restore(buses[i], &ix.states[k * nbuses + i]);
+	    buses[i]->quiet = 1;
+	 }
+	 seeking = 1;
+      }
+      index_free(&ix);
+   }
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   while (running && (ret = parse_candump(&pos, end, &frm, &stamp, &ifname, &iflen)) >= 0) {
+      if (ret > 0) {
+	 skipped++;
+	 continue;
+      }
+      if ((i = bus_index(ifname, iflen)) < 0) {
+	 other++;
+	 continue;
+      }
+      b = buses[i];
+      if (seeking) {
+	 if (stamp_us(&stamp) < from_us) {
+	    process_one(b, &frm, &stamp);
+	    continue;
+	 }
+	 // statistics cover what we show
+	 for (i = 0; i < nbuses; i++) {
+	    bus_clear_stats(buses[i]);
+	    buses[i]->quiet = 0;
+	 }
+	 seeking = 0;
+      }
+      if (base_us == 0)
+	 base_us = stamp_us(&stamp);
+      if (to > 0. && to_us == UINT64_MAX)
+	 to_us = base_us + (uint64_t) (to * 1.e6);
+      if (stamp_us(&stamp) > to_us)
+	 break;
+      if (frames == 0)
+	 first = stamp;
+      if (speed > 0) {
+	 // what we have shown so far goes out before we wait
+	 dump_flush();
+	 pace(&start, &first, &stamp, speed);
+      }
+      process_one(b, &frm, &stamp);
+      frames++;
+#ifdef PROF
+      prof_poll();
+#endif
+   }
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   munmap((void *)map, len);
+
+   sink->stop("end of log");
+   elapsed = (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) * 1.e-9;
+   fprintf(stderr, "replayed %lu frames (%lu lines skipped) in %.3f s, %.0f frames/s\n",
+	 frames, skipped, elapsed, elapsed > 0 ? frames / elapsed : 0.);
+   if (other)
+      fprintf(stderr, "%lu frames of other interfaces\n", other);
+   fprintf(stderr, "cpu %.3f s, %.0f ns/frame\n",
+	 cpu_seconds(), frames ? cpu_seconds() * 1.e9 / frames : 0.);
+   report_buses(stderr);
+
+   return 0;
+}
+
+// the values a chunk leaves behind, for the chunks after it to start from
+struct chunk_values {
+   int32_t ints[INT_COUNT];
+   float floats[FLOAT_COUNT];
+   bool switches[SWITCH_COUNT];
+   uint32_t int_known, float_known, switch_known;
+   uint64_t agg_us[AGG_SLOTS];   // the latest sample of each aggregate
+};
+
+// a chunk of a log analysed on its own, into its own copy of every bus
+struct worker {
+   pthread_t tid;
+   const char *start, *end;
+   struct bus *buses[MAX_BUSES];
+   struct chunk_values values[MAX_BUSES];
+   unsigned long frames, skipped, other;
+};
+
+// only the values of a known frame, no statistics and no post hooks
+static void values_one(struct chunk_values *v, const struct can_frame *frm, uint64_t now)
+{
+   const struct frame_plan *f;
+   const struct sig_plan *p, *last;
+   uint64_t le, be;
+   double val;
+   int idx;
+
+   if (frm->can_id & (CAN_EFF_FLAG | CAN_RTR_FLAG | CAN_ERR_FLAG) ||
+	 (idx = decode_index[frm->can_id]) == 0)
+      return;
+   f = &decode_frames[idx - 1];
+   memcpy(&le, frm->data, sizeof(le));
+   be = be64toh(le);
+   le = le64toh(le);
+   for (p = &decode_sigs[f->first], last = p + f->count; p < last; p++) {
+      val = sig_value(p, le, be);
+      switch (p->target) {
+      case T_INT:
+	 v->ints[p->slot] = (int32_t) val;
+	 v->int_known |= 1u << p->slot;
+	 if (now > v->agg_us[p->slot])
+	    v->agg_us[p->slot] = now;
+	 break;
+      case T_FLOAT:
+	 v->floats[p->slot] = val;
+	 v->float_known |= 1u << p->slot;
+	 if (now > v->agg_us[INT_COUNT + p->slot])
+	    v->agg_us[INT_COUNT + p->slot] = now;
+	 break;
+      case T_SWITCH:
+	 v->switches[p->slot] = val != 0.;
+	 v->switch_known |= 1u << p->slot;
+	 break;
+      }
+   }
+}
+
+// the values of src go over those of dst, where src has any
+static void values_merge(struct chunk_values *dst, const struct chunk_values *src)
+{
+   int i;
+
+   for (i = 0; i < INT_COUNT; i++)
+      if (src->int_known & 1u << i)
+	 dst->ints[i] = src->ints[i];
+   for (i = 0; i < FLOAT_COUNT; i++)
+      if (src->float_known & 1u << i)
+	 dst->floats[i] = src->floats[i];
+   for (i = 0; i < SWITCH_COUNT; i++)
+      if (src->switch_known & 1u << i)
+	 dst->switches[i] = src->switches[i];
+   for (i = 0; i < AGG_SLOTS; i++)
+      if (src->agg_us[i] > dst->agg_us[i])
+	 dst->agg_us[i] = src->agg_us[i];
+   dst->int_known |= src->int_known;
+   dst->float_known |= src->float_known;
+   dst->switch_known |= src->switch_known;
+}
+
+// start a worker bus from the values decoded before its chunk, so the post
+// hooks see what a plain replay would, and the windows of the aggregates
+// from the bucket a plain replay would be filling, should time go back
+static void values_seed(struct bus *b, const struct chunk_values *v)
+{
+   int i, w;
+
+   for (i = 0; i < INT_COUNT; i++)
+      if (v->int_known & 1u << i)
+	 b->int_mem[i] = v->ints[i];
+   for (i = 0; i < FLOAT_COUNT; i++)
+      if (v->float_known & 1u << i)
+	 b->float_mem[i] = v->floats[i];
+   for (i = 0; i < SWITCH_COUNT; i++)
+      if (v->switch_known & 1u << i)
+	 b->switches[i] = v->switches[i];
+   for (i = 0; i < AGG_SLOTS; i++)
+      if (v->agg_us[i])
+	 for (w = 0; w < AGG_WINDOWS; w++)
+	    agg_advance(&b->agg[i].win[w], w, v->agg_us[i]);
+   b->int_known = v->int_known;
+   b->float_known = v->float_known;
+}
+
+// the first pass, the values at the end of a chunk
+static void *values_chunk(void *arg)
+{
+   struct worker *w = arg;
+   struct can_frame frm;
+   struct timeval stamp;
+   const char *pos = w->start, *ifname;
+   int ret, iflen, i;
+
+   while (running && (ret = parse_candump(&pos, w->end, &frm, &stamp, &ifname, &iflen)) >= 0)
+      if (ret == 0 && (i = bus_index(ifname, iflen)) >= 0)
+	 values_one(&w->values[i], &frm, stamp_us(&stamp));
+   return NULL;
+}
+
+static void *analyse_chunk(void *arg)
+{
+   struct worker *w = arg;
+   struct can_frame frm;
+   struct timeval stamp;
+   const char *pos = w->start, *ifname;
+   int ret, iflen, i;
+
+   while (running && (ret = parse_candump(&pos, w->end, &frm, &stamp, &ifname, &iflen)) >= 0) {
+      if (ret > 0) {
+	 w->skipped++;
+	 continue;
+      }
+      if ((i = bus_index(ifname, iflen)) < 0) {
+	 w->other++;
+	 continue;
+      }
+      process_one(w->buses[i], &frm, &stamp);
+      w->frames++;
+   }
+   return NULL;
+}
+
+// decode a log on nthreads cores: it is split at line boundaries, each chunk
+// decoded into copies of the buses, and those merged in order at the end;
+// a first pass over all but the last chunk finds the values each chunk
+// starts from, which fuel, trip and TPMS depend on
+static int analyse_file(const char *fname, int nthreads)
+{
+   struct worker *w;
+   struct chunk_values seed[MAX_BUSES];
+   struct timespec start, now;
+   const char *map, *p;
+   unsigned long frames = 0, skipped = 0, other = 0;
+   double elapsed;
+   size_t len;
+   int i, j;
+
+   if (log_map(fname, &map, &len))
+      return 1;
+   if (len == 0)
+      return 0;
+   // no more chunks than a line each
+   if ((size_t) nthreads > len / 64 + 1)
+      nthreads = len / 64 + 1;
+   w = calloc(nthreads, sizeof(*w));
+   if (w == NULL) {
+      perror("calloc");
+      exit(1);
+   }
+
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   for (i = 0; i < nthreads; i++) {
+      if (i == 0)
+	 w[i].start = map;
+      else {
+	 p = memchr(map + len / nthreads * i, '\n', len - len / nthreads * i);
+	 w[i].start = p ? p + 1 : map + len;
+	 if (w[i].start < w[i - 1].start)
+	    w[i].start = w[i - 1].start;
+	 w[i - 1].end = w[i].start;
+      }
+      for (j = 0; j < nbuses; j++) {
+	 w[i].buses[j] = bus_alloc(buses[j]->name);
+	 w[i].buses[j]->quiet = 1;
+	 w[i].buses[j]->tpms.collect = 1;
+      }
+   }
+   w[nthreads - 1].end = map + len;
+   for (i = 0; i < nthreads - 1; i++)
+      if (start_thread(&w[i].tid, values_chunk, &w[i]) != 0) {
+	 fprintf(stderr, "cannot start analysis thread\n");
+	 exit(1);
+      }
+   memset(seed, 0, sizeof(seed));
+   for (i = 0; i < nthreads; i++) {
+      for (j = 0; j < nbuses; j++)
+	 values_seed(w[i].buses[j], &seed[j]);
+      if (i == nthreads - 1)
+	 break;
+      pthread_join(w[i].tid, NULL);
+      for (j = 0; j < nbuses; j++)
+	 values_merge(&seed[j], &w[i].values[j]);
+   }
+   for (i = 0; i < nthreads; i++)
+      if (start_thread(&w[i].tid, analyse_chunk, &w[i]) != 0) {
+	 fprintf(stderr, "cannot start analysis thread\n");
+	 exit(1);
+      }
+
+   for (i = 0; i < nthreads; i++) {
+      pthread_join(w[i].tid, NULL);
+      for (j = 0; j < nbuses; j++) {
+	 bus_merge(buses[j], w[i].buses[j]);
+	 bus_free(w[i].buses[j]);
+      }
+      frames += w[i].frames;
+      skipped += w[i].skipped;
+      other += w[i].other;
+   }
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   munmap((void *)map, len);
+   free(w);
+
+   elapsed = (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) * 1.e-9;
+   fprintf(stderr, "analysed %lu frames (%lu lines skipped) in %.3f s on %d threads, %.0f frames/s\n",
+	 frames, skipped, elapsed, nthreads, elapsed > 0 ? frames / elapsed : 0.);
+   if (other)
+      fprintf(stderr, "%lu frames of other interfaces\n", other);
+   fprintf(stderr, "cpu %.3f s, %.0f ns/frame\n",
+	 cpu_seconds(), frames ? cpu_seconds() * 1.e9 / frames : 0.);
+   report_buses(stderr);
+   return 0;
+}
+
+// the player: a thread writes a log to the buses, paced like a replay, and
+// the decoder matches what it receives against what was sent, for the
+// latency from send to the kernel timestamp and to the end of decoding,
+// and for drops
+#define PLAY_QUEUE (1 << 18)    // frames sent but not received yet, per bus
+#define PLAY_AHEAD 64           // how far ahead a received frame may match
+#define PLAY_HIST_US 10000      // latency histograms, 1 us buckets
+#define PLAY_DRAIN_US 200000    // wait for the last frames this long
+struct play_sent {
+   uint64_t ns;                 // CLOCK_REALTIME at send
+   canid_t id;
+   uint8_t dlc;
+   uint8_t data[CAN_MAX_DLEN];
+};
+struct play_queue {
+   uint32_t head __attribute__((aligned(64)));
+   uint32_t tail __attribute__((aligned(64)));
+   struct play_sent *sent;
+   unsigned long received, dropped, unexpected;
+};
+enum play_latencies {
+   PLAY_SOCKET,                 // send to kernel timestamp
+   PLAY_DECODED,                // send to decoded
+   PLAY_LATENCIES
+};
+struct player {
+   pthread_t tid;
+   const char *map;
+   size_t len;
+   double speed;
+   int sock[MAX_BUSES];
+   struct play_queue q[MAX_BUSES];
+   unsigned long sent, skipped, other, retries, waits;
+   double elapsed;
+   uint32_t hist[PLAY_LATENCIES][PLAY_HIST_US + 1];  // the last one is longer
+   uint64_t max_us[PLAY_LATENCIES];
+};
+
+static inline uint64_t realtime_ns(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_REALTIME, &ts);
+   return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void play_latency(int which, int64_t us)
+{
+   if (us < 0)
+      us = 0;
+   player->hist[which][us < PLAY_HIST_US ? us : PLAY_HIST_US]++;
+   if ((uint64_t) us > player->max_us[which])
+      player->max_us[which] = us;
+}
+
+// a frame the decoder took from the ring, find it among those sent on its bus
+static void play_match(const struct ring_slot *slot)
+{
+   struct play_queue *q;
+   const struct play_sent *p;
+   uint32_t head, tail, i;
+   uint64_t now = realtime_ns();
+   int k;
+
+   for (k = 0; k < nbuses; k++)
+      if (buses[k] == slot->b)
+	 break;
+   q = &player->q[k];
+   head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+   tail = q->tail;
+   for (i = tail; i != head && i - tail < PLAY_AHEAD; i++) {
+      p = &q->sent[i & (PLAY_QUEUE - 1)];
+      if (p->id == slot->frm.can_id && p->dlc == slot->frm.can_dlc &&
+	    memcmp(p->data, slot->frm.data, p->dlc) == 0)
+	 break;
+   }
+   if (i == head || i - tail == PLAY_AHEAD) {
+      // not ours, or further behind than we look
+      q->unexpected++;
+      return;
+   }
+   q->dropped += i - tail;
+   q->received++;
+   play_latency(PLAY_SOCKET, (int64_t) stamp_us(&slot->stamp) - (int64_t) (p->ns / 1000));
+   play_latency(PLAY_DECODED, (int64_t) (now - p->ns) / 1000);
+   __atomic_store_n(&q->tail, i + 1, __ATOMIC_RELEASE);
+}
+
+// the sending side, a frame at a time as it is due
+static void *play_thread(void *arg)
+{
+   struct player *pl = arg;
+   struct can_frame frm;
+   struct timeval stamp, first = { 0, 0 };
+   struct timespec start, now;
+   struct play_queue *q;
+   struct play_sent *p;
+   const char *pos = pl->map, *ifname;
+   int ret, iflen, i;
+
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   while (running && (ret = parse_candump(&pos, pl->map + pl->len, &frm, &stamp,
+	       &ifname, &iflen)) >= 0) {
+      if (ret > 0) {
+	 pl->skipped++;
+	 continue;
+      }
+      // with a single bus everything goes there, whatever it was logged on
+      if ((i = nbuses == 1 ? 0 : bus_index(ifname, iflen)) < 0) {
+	 pl->other++;
+	 continue;
+      }
+      if (pl->sent == 0)
+	 first = stamp;
+      else if (pl->speed > 0)
+	 pace(&start, &first, &stamp, pl->speed);
+
+      // the decoder is that far behind, wait for it rather than lose track
+      q = &pl->q[i];
+      while (q->head - __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) == PLAY_QUEUE && running) {
+	 pl->waits++;
+	 sched_yield();
+      }
+      p = &q->sent[q->head & (PLAY_QUEUE - 1)];
+      p->id = frm.can_id;
+      p->dlc = frm.can_dlc;
+      memcpy(p->data, frm.data, CAN_MAX_DLEN);
+      p->ns = realtime_ns();
+      __atomic_store_n(&q->head, q->head + 1, __ATOMIC_RELEASE);
+      while (write(pl->sock[i], &frm, sizeof(frm)) < 0) {
+	 if (errno != ENOBUFS && errno != EAGAIN) {
+	    perror("write");
+	    break;
+	 }
+	 // the interface queue is full at this speed
+	 pl->retries++;
+	 sched_yield();
+      }
+      pl->sent++;
+   }
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   pl->elapsed = (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) * 1.e-9;
+
+   // give the last frames time to come in, then stop the decoder
+   usleep(PLAY_DRAIN_US);
+   __atomic_store_n(&running, 0, __ATOMIC_SEQ_CST);
+   ring_wake();
+   return NULL;
+}
+
+// play the log fname onto the buses at speed times real time, as fast as
+// we can for speed <= 0
+static int play_start(const char *fname, double speed)
+{
+   int i;
+
+   player = calloc(1, sizeof(*player));
+   if (player == NULL) {
+      perror("calloc");
+      exit(1);
+   }
+   if (log_map(fname, &player->map, &player->len))
+      return 1;
+   if (player->len == 0) {
+      fprintf(stderr, "%s: empty log\n", fname);
+      return 1;
+   }
+   madvise((void *) player->map, player->len, MADV_SEQUENTIAL);
+   player->speed = speed;
+   for (i = 0; i < nbuses; i++) {
+      player->q[i].sent = malloc(PLAY_QUEUE * sizeof(*player->q[i].sent));
+      if (player->q[i].sent == NULL) {
+	 perror("malloc");
+	 exit(1);
+      }
+      // a socket of its own that receives nothing
+      player->sock[i] = can_open(buses[i]->name);
+      if (setsockopt(player->sock[i], SOL_CAN_RAW, CAN_RAW_FILTER, NULL, 0) < 0)
+	 perror("CAN_RAW_FILTER");
+   }
+   if (start_thread(&player->tid, play_thread, player) != 0) {
+      fprintf(stderr, "cannot start player thread\n");
+      exit(1);
+   }
+   return 0;
+}
+
+static void play_stop(void)
+{
+   int i;
+
+   pthread_join(player->tid, NULL);
+   for (i = 0; i < nbuses; i++)
+      close(player->sock[i]);
+   munmap((void *) player->map, player->len);
+}
+
+// the latency that p of the frames stayed below, in us
+static uint64_t play_percentile(int which, unsigned long total, double p)
+{
+   unsigned long n = 0;
+   int us;
+
+   for (us = 0; us < PLAY_HIST_US; us++)
+      if ((n += player->hist[which][us]) >= total * p)
+	 return us;
+   return player->max_us[which];
+}
+
+static void play_report(FILE *out)
+{
+   static const char *names[PLAY_LATENCIES] = { "socket", "decoded" };
+   const struct play_queue *q;
+   unsigned long received = 0;
+   int i, w;
+
+   fprintf(out, "played %lu frames in %.3f s, %.0f frames/s, %lu send retries, "
+	 "%lu waits for the decoder\n", player->sent, player->elapsed,
+	 player->elapsed > 0 ? player->sent / player->elapsed : 0.,
+	 player->retries, player->waits);
+   if (player->other)
+      fprintf(out, "%lu frames of other interfaces not played\n", player->other);
+   for (i = 0; i < nbuses; i++) {
+      q = &player->q[i];
+      received += q->received;
+      // what is still queued never came back
+      fprintf(out, "%s: %lu received, %lu dropped (%.3f%%), %lu unexpected\n",
+	    buses[i]->name, q->received, q->dropped + (q->head - q->tail),
+	    q->head ? (q->dropped + (q->head - q->tail)) * 100. / q->head : 0.,
+	    q->unexpected);
+   }
+   if (received == 0)
+      return;
+   fprintf(out, "latency us       p50      p90      p99    p99.9      max\n");
+   for (w = 0; w < PLAY_LATENCIES; w++)
+      fprintf(out, "  %-9s %8lu %8lu %8lu %8lu %8lu\n", names[w],
+	    (unsigned long) play_percentile(w, received, .5),
+	    (unsigned long) play_percentile(w, received, .9),
+	    (unsigned long) play_percentile(w, received, .99),
+	    (unsigned long) play_percentile(w, received, .999),
+	    (unsigned long) player->max_us[w]);
+}
+
+// background writer for recordings
+static void *record_writer(void *arg)
+{
+   struct recorder *rec = arg;
+   const char *p;
+   ssize_t ret;
+   size_t len;
+   int b;
+
+   pthread_mutex_lock(&rec->lock);
+   for (;;) {
+      while (rec->pending < 0 && !rec->stop)
+	 pthread_cond_wait(&rec->cond, &rec->lock);
+      if (rec->pending < 0)
+	 break;
+      b = rec->pending;
+      len = rec->pending_len;
+      pthread_mutex_unlock(&rec->lock);
+
+      for (p = rec->buf[b]; len > 0; p += ret, len -= ret) {
+	 ret = write(rec->fd, p, len);
+	 if (ret < 0) {
+	    if (errno == EINTR) {
+	       ret = 0;
+	       continue;
+	    }
+	    perror("recording");
+	    rec->error = 1;
+	    break;
+	 }
+      }
+
+      pthread_mutex_lock(&rec->lock);
+      rec->pending = -1;
+      pthread_cond_signal(&rec->cond);
+   }
+   pthread_mutex_unlock(&rec->lock);
+   return NULL;
+}
+
+// hand the current buffer to the writer and carry on with the other one
+static void record_flush(struct recorder *rec)
+{
+   pthread_mutex_lock(&rec->lock);
+   if (rec->pending >= 0)
+      rec->stalls++;
+   while (rec->pending >= 0)
+      pthread_cond_wait(&rec->cond, &rec->lock);
+   rec->pending = rec->cur;
+   rec->pending_len = rec->fill;
+   pthread_cond_signal(&rec->cond);
+   pthread_mutex_unlock(&rec->lock);
+   rec->cur ^= 1;
+   rec->fill = 0;
+}
+
+// record the values of bus b to fname
+static int record_open(struct bus *b, const char *fname)
+{
+   struct rec_header hdr;
+   struct recorder *rec;
+
+   rec = calloc(1, sizeof(*rec));
+   if (rec == NULL) {
+      perror("calloc");
+      return 1;
+   }
+   rec->pending = -1;
+   pthread_mutex_init(&rec->lock, NULL);
+   pthread_cond_init(&rec->cond, NULL);
+   b->rec = rec;
+   rec->fd = open(fname, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+   if (rec->fd < 0) {
+      perror(fname);
+      return 1;
+   }
+   rec->buf[0] = malloc(REC_BUF_SIZE);
+   rec->buf[1] = malloc(REC_BUF_SIZE);
+   if (rec->buf[0] == NULL || rec->buf[1] == NULL) {
+      perror("malloc");
+      return 1;
+   }
+
+   memset(&hdr, 0, sizeof(hdr));
+   memcpy(hdr.magic, REC_MAGIC, sizeof(hdr.magic));
+   hdr.version = REC_VERSION;
+   hdr.size = sizeof(struct rec_record);
+   hdr.ints = INT_COUNT;
+   hdr.floats = FLOAT_COUNT;
+   hdr.switches = SWITCH_COUNT;
+   memcpy(rec->buf[0], &hdr, sizeof(hdr));
+   rec->fill = sizeof(hdr);
+   // everything counts as changed in the first record
+   memset(&rec->last, 0xff, sizeof(rec->last));
+
+   if (start_thread(&rec->tid, record_writer, rec) != 0) {
+      fprintf(stderr, "cannot start recording thread\n");
+      return 1;
+   }
+   return 0;
+}
+
+// append the current values of bus b to its recording
+static void record_one(struct bus *b, uint64_t now)
+{
+   struct recorder *rec = b->rec;
+   struct rec_record *r;
+   uint32_t changed = 0;
+   int i;
+
+   if (rec->fill + sizeof(*r) > REC_BUF_SIZE)
+      record_flush(rec);
+   r = (struct rec_record *) (rec->buf[rec->cur] + rec->fill);
+   rec->fill += sizeof(*r);
+
+   r->stamp_us = now;
+   r->switches = 0;
+   for (i = 0; i < INT_COUNT; i++) {
+      r->ints[i] = b->int_mem[i];
+      if (r->ints[i] != rec->last.ints[i])
+	 changed |= 1u << i;
+   }
+   for (i = 0; i < FLOAT_COUNT; i++) {
+      r->floats[i] = b->float_mem[i];
+      if (memcmp(&r->floats[i], &rec->last.floats[i], sizeof(float)) != 0)
+	 changed |= 1u << (INT_COUNT + i);
+   }
+   for (i = 0; i < SWITCH_COUNT; i++) {
+      r->switches |= (uint32_t) b->switches[i] << i;
+      if ((r->switches ^ rec->last.switches) & (1u << i))
+	 changed |= 1u << (INT_COUNT + FLOAT_COUNT + i);
+   }
+   r->changed = changed;
+   rec->last = *r;
+   rec->records++;
+}
+
+// write out what is left and wait for the writer to finish
+static int record_close(struct bus *b)
+{
+   struct recorder *rec = b->rec;
+   int error;
+
+   if (rec == NULL)
+      return 0;
+   if (rec->fill > 0)
+      record_flush(rec);
+   pthread_mutex_lock(&rec->lock);
+   rec->stop = 1;
+   pthread_cond_signal(&rec->cond);
+   pthread_mutex_unlock(&rec->lock);
+   pthread_join(rec->tid, NULL);
+   if (close(rec->fd) < 0) {
+      perror("recording");
+      rec->error = 1;
+   }
+   free(rec->buf[0]);
+   free(rec->buf[1]);
+   fprintf(stderr, "%s: recorded %lu records, writer stalled %lu times\n",
+	 b->name, rec->records, rec->stalls);
+   error = rec->error;
+   free(rec);
+   b->rec = NULL;
+   return error;
+}
+
+// publish the values of bus b in the shared memory segment name, readers
+// find it as /dev/shm/name
+static int shm_open_bus(struct bus *b, const char *name)
+{
+   static const struct {
+      int count;
+      const char **names;
+      size_t offset;
+   } groups[] = {
+      { INT_COUNT,    int_names,    offsetof(struct scooby_shm, int_names) },
+      { FLOAT_COUNT,  float_names,  offsetof(struct scooby_shm, float_names) },
+      { AUX_COUNT,    aux_names,    offsetof(struct scooby_shm, aux_names) },
+      { SWITCH_COUNT, switch_names, offsetof(struct scooby_shm, switch_names) },
+   };
+   _Static_assert(INT_COUNT <= SCOOBY_SHM_SLOTS && FLOAT_COUNT <= SCOOBY_SHM_SLOTS &&
+	 AUX_COUNT <= SCOOBY_SHM_SLOTS && SWITCH_COUNT <= SCOOBY_SHM_SLOTS,
+	 "shared memory slots too small");
+   struct scooby_shm *m;
+   char *names;
+   int fd, i, j;
+
+   fd = shm_open(name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+   if (fd < 0) {
+      perror(name);
+      return 1;
+   }
+   if (ftruncate(fd, sizeof(*m)) < 0) {
+      perror(name);
+      close(fd);
+      return 1;
+   }
+   m = mmap(NULL, sizeof(*m), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   close(fd);
+   if (m == MAP_FAILED) {
+      perror("mmap");
+      return 1;
+   }
+
+   m->version = SCOOBY_SHM_VERSION;
+   m->size = sizeof(*m);
+   m->pid = getpid();
+   snprintf(m->bus, sizeof(m->bus), "%s", b->name);
+   m->n_ints = INT_COUNT;
+   m->n_floats = FLOAT_COUNT;
+   m->n_aux = AUX_COUNT;
+   m->n_switches = SWITCH_COUNT;
+   for (i = 0; i < (int) (sizeof(groups)/sizeof(groups[0])); i++) {
+      names = (char *) m + groups[i].offset;
+      for (j = 0; j < groups[i].count; j++)
+	 strncpy(names + j * SCOOBY_SHM_NAME, groups[i].names[j], SCOOBY_SHM_NAME - 1);
+   }
+   for (i = 0; i < SWITCH_COUNT; i++)
+      m->v.switches[i] = b->switches[i];
+   // readers check the magic last
+   __atomic_thread_fence(__ATOMIC_RELEASE);
+   memcpy(m->magic, SCOOBY_SHM_MAGIC, sizeof(m->magic));
+   b->shm = m;
+   return 0;
+}
+
+// copy the values of b after decoding frame f, under the seqlock
+static void shm_publish(struct bus *b, const struct frame_plan *f, uint64_t now)
+{
+   struct scooby_shm *m = b->shm;
+   const struct sig_plan *p, *last;
+   uint32_t seq = m->seq;
+   int i;
+
+   // odd while we write, readers retry
+   __atomic_store_n(&m->seq, seq + 1, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_RELEASE);
+
+   // the signals of this frame ...
+   for (p = &decode_sigs[f->first], last = p + f->count; p < last; p++) {
+      switch (p->target) {
+      case T_INT:
+	 m->v.ints_us[p->slot] = now;
+	 break;
+      case T_FLOAT:
+	 m->v.floats_us[p->slot] = now;
+	 break;
+      case T_AUX:
+	 m->v.aux_us[p->slot] = now;
+	 break;
+      case T_SWITCH:
+	 m->v.switches_us[p->slot] = now;
+	 break;
+      }
+   }
+   // ... and what the post hooks derived from it
+   for (i = 0; i < AUX_COUNT; i++)
+      if (m->v.aux[i] != b->aux_mem[i])
+	 m->v.aux_us[i] = now;
+
+   memcpy(m->v.ints, b->int_mem, sizeof(b->int_mem));
+   memcpy(m->v.floats, b->float_mem, sizeof(b->float_mem));
+   memcpy(m->v.aux, b->aux_mem, sizeof(b->aux_mem));
+   for (i = 0; i < SWITCH_COUNT; i++)
+      m->v.switches[i] = b->switches[i];
+   m->v.stamp_us = now;
+   m->v.frames++;
+
+   __atomic_store_n(&m->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+// leave the last values for readers, but tell them nobody updates them
+static void shm_close(struct bus *b)
+{
+   if (b->shm == NULL)
+      return;
+   __atomic_store_n(&b->shm->pid, 0, __ATOMIC_RELEASE);
+   munmap(b->shm, sizeof(*b->shm));
+   b->shm = NULL;
+}
+
+// turn a recording back into dump columns, from and to as for
+// replay_file(); records are sorted by time, so we find from by bisection
+static int record_print(const char *fname, double from, double to)
+{
+   const struct rec_header *hdr;
+   const struct rec_record *r, *end, *lo, *hi, *mid;
+   uint64_t from_us, to_us = UINT64_MAX;
+   struct timeval stamp;
+   struct stat st;
+   const char *map;
+   bool sw[SWITCH_COUNT];
+   int fd, i;
+
+   fd = open(fname, O_RDONLY);
+   if (fd < 0) {
+      perror(fname);
+      return 1;
+   }
+   if (fstat(fd, &st) < 0) {
+      perror("fstat");
+      close(fd);
+      return 1;
+   }
+   if (st.st_size < (off_t) sizeof(*hdr)) {
+      fprintf(stderr, "%s: not a recording\n", fname);
+      close(fd);
+      return 1;
+   }
+   map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if (map == MAP_FAILED) {
+      perror("mmap");
+      return 1;
+   }
+   madvise((void *)map, st.st_size, MADV_SEQUENTIAL);
+
+   hdr = (const struct rec_header *) map;
+   if (memcmp(hdr->magic, REC_MAGIC, sizeof(hdr->magic)) != 0 ||
+	 hdr->version != REC_VERSION || hdr->size != sizeof(*r) ||
+	 hdr->ints != INT_COUNT || hdr->floats != FLOAT_COUNT ||
+	 hdr->switches != SWITCH_COUNT) {
+      fprintf(stderr, "%s: not a recording of this version\n", fname);
+      munmap((void *)map, st.st_size);
+      return 1;
+   }
+
+   r = (const struct rec_record *) (map + sizeof(*hdr));
+   end = r + (st.st_size - sizeof(*hdr)) / sizeof(*r);
+   if (r < end && to > 0.)
+      to_us = r->stamp_us + (uint64_t) (to * 1.e6);
+   if (r < end && from > 0.) {
+      from_us = r->stamp_us + (uint64_t) (from * 1.e6);
+      lo = r;
+      hi = end;
+      while (lo < hi) {
+	 mid = lo + (hi - lo) / 2;
+	 if (mid->stamp_us < from_us)
+	    lo = mid + 1;
+	 else
+	    hi = mid;
+      }
+      r = lo;
+   }
+   for (; r < end && r->stamp_us <= to_us; r++) {
+      stamp.tv_sec = r->stamp_us / 1000000;
+      stamp.tv_usec = r->stamp_us % 1000000;
+      for (i = 0; i < SWITCH_COUNT; i++)
+	 sw[i] = (r->switches >> i) & 1;
+      print_columns(NULL, &stamp, r->ints, r->floats, sw);
+   }
+   dump_flush();
+
+   munmap((void *)map, st.st_size);
+   return 0;
+}
+
+// nanoseconds on the monotonic clock
+static inline uint64_t mono_ns(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// hardware counters for the benchmark, a group led by cycles
+enum perf_counters {
+   PERF_CYCLES,
+   PERF_INSTRUCTIONS,
+   PERF_CACHE_MISSES,
+   PERF_COUNT
+};
+static int perf_fd[PERF_COUNT] = { -1, -1, -1 };
+
+static int perf_open(void)
+{
+   static const uint64_t config[PERF_COUNT] = {
+      PERF_COUNT_HW_CPU_CYCLES,
+      PERF_COUNT_HW_INSTRUCTIONS,
+      PERF_COUNT_HW_CACHE_MISSES,
+   };
+   struct perf_event_attr attr;
+   int i;
+
+   for (i = 0; i < PERF_COUNT; i++) {
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = config[i];
+      attr.disabled = (i == 0);
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_GROUP;
+      perf_fd[i] = syscall(SYS_perf_event_open, &attr, 0, -1,
+	    i == 0 ? -1 : perf_fd[0], 0);
+      if (perf_fd[i] < 0) {
+	 while (i-- > 0) {
+	    close(perf_fd[i]);
+	    perf_fd[i] = -1;
+	 }
+	 return 1;
+      }
+   }
+   return 0;
+}
+
+// read the counter group, values[] in enum perf_counters order
+static int perf_read(uint64_t *values)
+{
+   uint64_t buf[1 + PERF_COUNT];
+
+   if (perf_fd[0] < 0 || read(perf_fd[0], buf, sizeof(buf)) != sizeof(buf))
+      return 1;
+   memcpy(values, buf + 1, PERF_COUNT * sizeof(uint64_t));
+   return 0;
+}
+
+// for grouping benchmark frames by ID
+struct bench_ref {
+   canid_t id;
+   uint32_t idx;
+};
+
+static int bench_ref_cmp(const void *a, const void *b)
+{
+   const struct bench_ref *ra = a, *rb = b;
+
+   if (ra->id != rb->id)
+      return ra->id < rb->id ? -1 : 1;
+   return ra->idx < rb->idx ? -1 : ra->idx > rb->idx;
+}
+
+// check the parser against the scalar one on every line of a log and time
+// both, returns 1 if they disagree anywhere
+static int bench_parser(const char *map, size_t len)
+{
+   static int (*const parsers[2])(const char **, const char *, struct can_frame *,
+	 struct timeval *, const char **, int *) = {
+      parse_candump, parse_candump_scalar
+   };
+   struct can_frame fa, fb;
+   struct timeval ta, tb;
+   const char *pa, *pb, *na = NULL, *nb = NULL, *end = map + len;
+   unsigned long lines = 0, bad = 0;
+   uint64_t start, ns[2];
+   volatile canid_t sink;
+   int ra, rb, la = 0, lb = 0, k, r, reps;
+
+   for (pa = pb = map; ; lines++) {
+      ra = parse_candump(&pa, end, &fa, &ta, &na, &la);
+      rb = parse_candump_scalar(&pb, end, &fb, &tb, &nb, &lb);
+      if (ra != rb || pa != pb || (ra == 0 && (memcmp(&fa, &fb, sizeof(fa)) != 0 ||
+		  ta.tv_sec != tb.tv_sec || ta.tv_usec != tb.tv_usec ||
+		  na != nb || la != lb))) {
+	 if (bad++ < 5)
+	    fprintf(stderr, "parser: line %lu differs\n", lines + 1);
+	 pa = pb;
+      }
+      if (rb < 0)
+	 break;
+   }
+
+   // at least 256 MB each
+   reps = 1 + (256 << 20) / len;
+   for (k = 0; k < 2; k++) {
+      start = mono_ns();
+      for (r = 0; r < reps; r++)
+	 for (pa = map; (ra = parsers[k](&pa, end, &fa, &ta, &na, &la)) >= 0; )
+	    sink = fa.can_id;
+      ns[k] = mono_ns() - start;
+   }
+   (void) sink;
+   fprintf(stderr, "parser: %lu lines, %lu differ, %.0f MB/s, scalar %.0f MB/s\n",
+	 lines, bad, (double) len * reps * 1.e3 / ns[0], (double) len * reps * 1.e3 / ns[1]);
+   return bad != 0;
+}
+
+// load a candump log into memory, scale times back to back, and time the
+// decoder on it: all frames in order, then each ID on its own
+static int bench_file(const char *fname, int scale)
+{
+   struct bus *b = buses[0];
+   struct can_frame *frames = NULL, *f;
+   struct timeval *stamps = NULL, *t, first = { 0, 0 }, last = { 0, 0 };
+   struct bench_ref *refs;
+   struct stat st;
+   const char *map, *pos, *end;
+   uint64_t start, ns, span, perf[PERF_COUNT], known = 0, unchanged = 0;
+   size_t n = 0, max = 0, i, j, k, total;
+   int fd, ret, have_perf;
+
+   fd = open(fname, O_RDONLY);
+   if (fd < 0) {
+      perror(fname);
+      return 1;
+   }
+   if (fstat(fd, &st) < 0 || st.st_size == 0) {
+      fprintf(stderr, "%s: empty log\n", fname);
+      close(fd);
+      return 1;
+   }
+   map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if (map == MAP_FAILED) {
+      perror("mmap");
+      return 1;
+   }
+
+   // parse it all up front, the parser is not what we measure here
+   pos = map;
+   end = map + st.st_size;
+   for (;;) {
+      if (n == max) {
+	 max = max ? 2*max : 65536;
+	 f = realloc(frames, max * sizeof(*frames));
+	 t = realloc(stamps, max * sizeof(*stamps));
+	 if (f == NULL || t == NULL) {
+	    perror("realloc");
+	    return 1;
+	 }
+	 frames = f;
+	 stamps = t;
+      }
+      ret = parse_candump(&pos, end, &frames[n], &stamps[n], NULL, NULL);
+      if (ret < 0)
+	 break;
+      if (ret == 0) {
+	 if (n == 0)
+	    first = stamps[n];
+	 last = stamps[n];
+	 n++;
+      }
+   }
+   ret = bench_parser(map, st.st_size);
+   munmap((void *)map, st.st_size);
+   if (ret)
+      return 1;
+   if (n == 0) {
+      fprintf(stderr, "%s: no frames\n", fname);
+      return 1;
+   }
+
+   // synthetic bigger logs: copies back to back, time running on
+   total = n * scale;
+   frames = realloc(frames, total * sizeof(*frames));
+   stamps = realloc(stamps, total * sizeof(*stamps));
+   refs = malloc(total * sizeof(*refs));
+   if (frames == NULL || stamps == NULL || refs == NULL) {
+      perror("malloc");
+      return 1;
+   }
+   span = stamp_us(&last) - stamp_us(&first) + 10000;
+   for (k = 1; k < (size_t) scale; k++)
+      for (i = 0; i < n; i++) {
+	 j = k*n + i;
+	 frames[j] = frames[i];
+	 stamps[j].tv_sec = stamps[i].tv_sec + (k * span) / 1000000;
+	 stamps[j].tv_usec = stamps[i].tv_usec + (k * span) % 1000000;
+	 if (stamps[j].tv_usec >= 1000000) {
+	    stamps[j].tv_sec++;
+	    stamps[j].tv_usec -= 1000000;
+	 }
+      }
+
+   fprintf(stderr, "benchmark: %zu frames (%d x %zu)\n", total, scale, n);
+
+   // warm up caches and branch predictors
+   for (i = 0; i < n; i++)
+      process_one(b, &frames[i], &stamps[i]);
+
+   have_perf = perf_open() == 0;
+   if (have_perf) {
+      ioctl(perf_fd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+      ioctl(perf_fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+   }
+   start = mono_ns();
+   for (i = 0; i < total; i++)
+      process_one(b, &frames[i], &stamps[i]);
+   ns = mono_ns() - start;
+   if (have_perf) {
+      ioctl(perf_fd[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+      have_perf = perf_read(perf) == 0;
+   }
+   dump_flush();
+
+   fprintf(stderr, "all frames: %.1f ns/frame, %.2f Mframes/s\n",
+	 (double) ns / total, total * 1.e3 / ns);
+   if (have_perf)
+      fprintf(stderr, "            %.1f cycles/frame, %.1f instructions/frame, "
+	    "%.3f cache misses/frame\n",
+	    (double) perf[PERF_CYCLES] / total,
+	    (double) perf[PERF_INSTRUCTIONS] / total,
+	    (double) perf[PERF_CACHE_MISSES] / total);
+   else
+      fprintf(stderr, "            no perf counters available\n");
+   for (i = 0; i < (size_t) decode_nframes; i++) {
+      known += b->stats[i].count;
+      unchanged += b->stats[i].unchanged;
+   }
+   if (decode_full)
+      fprintf(stderr, "            all known frames decoded in full (-F)\n");
+   else if (known)
+      fprintf(stderr, "            %.1f%% of known frames unchanged, not decoded again\n",
+	    100. * unchanged / known);
+
+   // each ID on its own, in order of arrival within the ID
+   for (i = 0; i < total; i++) {
+      refs[i].id = frames[i].can_id;
+      refs[i].idx = i;
+   }
+   qsort(refs, total, sizeof(*refs), bench_ref_cmp);
+   fprintf(stderr, "per ID:\n");
+   for (i = 0; i < total; i = j) {
+      for (j = i; j < total && refs[j].id == refs[i].id; j++)
+	 ;
+      start = mono_ns();
+      for (k = i; k < j; k++)
+	 process_one(b, &frames[refs[k].idx], &stamps[refs[k].idx]);
+      ns = mono_ns() - start;
+      dump_flush();
+      if (refs[i].id & CAN_EFF_FLAG)
+	 fprintf(stderr, "  %08x", refs[i].id & CAN_EFF_MASK);
+      else
+	 fprintf(stderr, "  %03x     ", refs[i].id);
+      fprintf(stderr, " %9zu frames %8.1f ns/frame%s\n", j - i, (double) ns / (j - i),
+	    (refs[i].id & CAN_EFF_FLAG) || !decode_index[refs[i].id & CAN_SFF_MASK] ?
+	    "  (unknown)" : "");
+   }
+
+   for (i = 0; i < PERF_COUNT; i++)
+      if (perf_fd[i] >= 0)
+	 close(perf_fd[i]);
+   free(refs);
+   free(frames);
+   free(stamps);
+   return 0;
+}
+
+static void usage(const char *name)
+{
+   printf("syntax: %s [OPTIONS] IFNAME...\n", name);
+   printf("        %s [OPTIONS] -p LOGFILE [-x SPEED] IFNAME...\n", name);
+   printf("        %s [OPTIONS] -r LOGFILE [-x SPEED | -j N] [-s FROM[:TO]] [IFNAME...]\n", name);
+   printf("        %s [-s FROM[:TO]] -P RECORDING\n", name);
+   printf("        %s [OPTIONS] -b LOGFILE [-n SCALE]\n\n", name);
+   printf("  IFNAME...   up to %d buses, each decoded on its own, n shows the next one\n",
+	 MAX_BUSES);
+   printf("  -r LOGFILE  decode a candump log instead of a live interface, only the\n");
+   printf("              frames of IFNAME... if given, else all as one bus\n");
+   printf("  -x SPEED    replay at SPEED times real time (default 0 = as fast as possible)\n");
+   printf("  -p LOGFILE  play a candump log onto IFNAME... (vcan) at -x SPEED while\n");
+   printf("              decoding it back, and report latency and drops\n");
+   printf("  -s FROM[:TO] only from FROM to TO seconds into the log or recording,\n");
+   printf("              logs get an index LOGFILE.idx to start there at once\n");
+   printf("  -j N        analyse the log on N threads (0 = all cores) and only report\n");
+   printf("  -B N        receive up to N frames per syscall (default %d, max %d)\n",
+	 RECV_BATCH_DEFAULT, RECV_BATCH_MAX);
+   printf("  -k          known-only, have the kernel drop frames we do not decode and\n");
+   printf("              only sample the rest for unknown IDs once a second\n");
+   printf("  -w FILE     record values to a binary FILE instead of printing them,\n");
+   printf("              further buses to FILE.IFNAME\n");
+   printf("  -P FILE     print a binary recording as dump columns and exit\n");
+   printf("  -o OUTPUT   tui, columns, csv, tsv or null for none at all (default tui,\n");
+   printf("              columns if called as ScoobyCAN_dump)\n");
+   printf("  -A SECONDS  dump the means over the last 1, 10 or 60 seconds instead of\n");
+   printf("              the latest values\n");
+   printf("  -m NAME     publish values in shared memory /dev/shm/NAME,\n");
+   printf("              further buses in NAME.IFNAME\n");
+   printf("  -b LOGFILE  benchmark the decoder on a candump log held in memory\n");
+   printf("  -n SCALE    benchmark on SCALE back to back copies of the log\n");
+   printf("  -d DBCFILE  decode the signals of a DBC file instead of the built-in ones\n");
+   printf("  -u          analyse the payloads of unknown IDs for counters, checksums\n");
+   printf("              and signals following RPM or SPEED, in the report\n");
+   printf("  -F          decode every frame in full, also when its payload is the same\n");
+   printf("              as last time\n");
+   printf("  -R HZ       repaint the screen HZ times per second (default %d)\n",
+	 RENDER_HZ_DEFAULT);
+   printf("  -T KEY=VALUE,...  TPMS settings, steer (deg, default %g), speed (km/h, %g),\n",
+	 (double) TPMS_STEER_LIMIT, TPMS_MIN_SPEED);
+   printf("              accel (g, %g), tau (s, %g), ratio (%g), time (s, %g)\n",
+	 TPMS_ACCEL_LIMIT, TPMS_TAU, TPMS_WARN_RATIO, TPMS_WARN_TIME);
+   exit(1);
+}
+
+int main(int argc, char **argv)
+{
+   const char *logfile = NULL, *dbcfile = NULL, *recfile = NULL;
+   const char *benchfile = NULL, *shmname = NULL, *recprint = NULL;
+   const char *playfile = NULL, *output = NULL, *self;
+   char *e, *opts, *val;
+   char fname[PATH_MAX];
+   int bench_scale = 1, threads = -1;
+   struct sigaction sa;
+   double speed = 0., from = 0., to = 0.;
+   int opt, ret, i;
+
+   // keep stdout clean for the column output
+   fprintf(stderr, "known frame IDs: %d\n",FRAME_COUNT);
+   fprintf(stderr, "monitored floats: %d\n",FLOAT_COUNT);
+   fprintf(stderr, "monitored ints: %d\n\n\n",INT_COUNT);
+   gettimeofday(&tv, NULL);
+   fprintf(stderr, "current timestamp [%010ld.%06ld]\n\n",tv.tv_sec, tv.tv_usec);
+
+   while ((opt = getopt(argc, argv, "r:x:j:s:p:B:R:T:d:kuFw:P:o:m:A:b:n:")) != -1) {
+      switch (opt) {
+      case 'r':
+	 logfile = optarg;
+	 break;
+      case 'x':
+	 speed = atof(optarg);
+	 break;
+      case 'j':
+	 threads = atoi(optarg);
+	 if (threads == 0)
+	    threads = sysconf(_SC_NPROCESSORS_ONLN);
+	 if (threads < 1 || threads > ANALYSE_THREADS_MAX)
+	    usage(argv[0]);
+	 break;
+      case 'B':
+	 recv_batch = atoi(optarg);
+	 if (recv_batch < 1 || recv_batch > RECV_BATCH_MAX)
+	    usage(argv[0]);
+	 break;
+      case 'd':
+	 dbcfile = optarg;
+	 break;
+      case 'k':
+	 known_only = 1;
+	 break;
+      case 'F':
+	 decode_full = 1;
+	 break;
+      case 'u':
+	 unknown_rev = 1;
+	 break;
+      case 'w':
+	 recfile = optarg;
+	 break;
+      case 'P':
+	 recprint = optarg;
+	 break;
+      case 'o':
+	 output = optarg;
+	 break;
+      case 'T':
+	 for (opts = optarg; *opts != '\0'; ) {
+	    i = getsubopt(&opts, tpms_keys, &val);
+	    if (i < 0 || val == NULL)
+	       usage(argv[0]);
+	    *tpms_settings[i] = strtod(val, &e);
+	    if (*e != '\0' || *tpms_settings[i] < 0.)
+	       usage(argv[0]);
+	 }
+	 if (tpms_cfg.tau <= 0.)
+	    usage(argv[0]);
+	 break;
+      case 'p':
+	 playfile = optarg;
+	 break;
+      case 's':
+	 from = strtod(optarg, &e);
+	 if (*e == ':')
+	    to = strtod(e + 1, &e);
+	 if (*e != '\0' || from < 0. || (to > 0. && to <= from))
+	    usage(argv[0]);
+	 break;
+      case 'm':
+	 shmname = optarg;
+	 break;
+      case 'A':
+	 for (dump_window = 0; dump_window < AGG_WINDOWS; dump_window++)
+	    if (agg_window_us[dump_window] == strtoul(optarg, NULL, 10) * 1000000)
+	       break;
+	 if (dump_window == AGG_WINDOWS)
+	    usage(argv[0]);
+	 break;
+      case 'b':
+	 benchfile = optarg;
+	 break;
+      case 'n':
+	 bench_scale = atoi(optarg);
+	 if (bench_scale < 1)
+	    usage(argv[0]);
+	 break;
+      case 'R':
+	 render_hz = atoi(optarg);
+	 if (render_hz < 1 || render_hz > 1000)
+	    usage(argv[0]);
+	 break;
+      default:
+	 usage(argv[0]);
+      }
+   }
+   // the output by name, else the one our own name asks for
+   if (output == NULL) {
+      self = strrchr(argv[0], '/');
+      self = self != NULL ? self + 1 : argv[0];
+      output = strcmp(self, "ScoobyCAN_dump") == 0 ? dump_format_names[DUMP_COLUMNS] : "tui";
+   }
+   if (strcmp(output, "tui") == 0)
+      sink = &sinks[SINK_TUI];
+   else if (strcmp(output, "null") == 0)
+      sink = &sinks[SINK_NULL];
+   else {
+      for (dump.format = 0; dump.format < DUMP_FORMATS; dump.format++)
+	 if (strcmp(output, dump_format_names[dump.format]) == 0)
+	    break;
+      if (dump.format == DUMP_FORMATS)
+	 usage(argv[0]);
+      sink = &sinks[SINK_DUMP];
+   }
+   // a recording takes the place of any lines, the screen stays
+   if (recfile != NULL && !sink->screen)
+      sink = &sinks[SINK_RECORD];
+   if (recfile != NULL)
+      sink_line = line_record;
+   else if (sink == &sinks[SINK_DUMP] && dump_window >= 0)
+      sink_line = line_window;
+   else
+      sink_line = sink->line;
+
+   if (recprint != NULL)
+      return record_print(recprint, from, to);
+   if (logfile != NULL && benchfile != NULL)
+      usage(argv[0]);
+   if ((from > 0. || to > 0.) && (logfile == NULL || threads > 0))
+      usage(argv[0]);
+   // the sampled frames of known-only mode say little about a payload
+   if (unknown_rev && known_only)
+      usage(argv[0]);
+   // the player needs live buses and every frame it sent back
+   if (playfile != NULL && (logfile != NULL || benchfile != NULL || known_only ||
+	    argc - optind < 1))
+      usage(argv[0]);
+   // an analysis only reports, in no particular order while it runs
+   if (threads > 0 && (logfile == NULL || speed > 0 || recfile != NULL ||
+	    shmname != NULL || dump_window >= 0))
+      usage(argv[0]);
+   if ((logfile == NULL && benchfile == NULL && argc - optind < 1) ||
+	 (benchfile != NULL && argc - optind != 0) || argc - optind > MAX_BUSES)
+      usage(argv[0]);
+
+   if (decoder_init(dbcfile))
+      return 1;
+   for (i = optind; i < argc; i++)
+      bus_new(argv[i]);
+   if (nbuses == 0) {
+      any_iface = 1;
+      bus_new("log");
+   }
+   for (i = 0; recfile != NULL && i < nbuses; i++) {
+      if (i == 0)
+	 snprintf(fname, sizeof(fname), "%s", recfile);
+      else
+	 snprintf(fname, sizeof(fname), "%s.%s", recfile, buses[i]->name);
+      if (record_open(buses[i], fname))
+	 return 1;
+   }
+   for (i = 0; shmname != NULL && i < nbuses; i++) {
+      if (i == 0)
+	 snprintf(fname, sizeof(fname), "/%s", shmname);
+      else
+	 snprintf(fname, sizeof(fname), "/%s.%s", shmname, buses[i]->name);
+      if (shm_open_bus(buses[i], fname))
+	 return 1;
+   }
+
+   if (threads > 0) {
+      memset(&sa, 0, sizeof(sa));
+      sa.sa_handler = stop_running;
+      sigaction(SIGINT, &sa, NULL);
+      sigaction(SIGTERM, &sa, NULL);
+      return analyse_file(logfile, threads);
+   }
+
+   if (sink->open(benchfile != NULL))
+      return 1;
+
+   // leave the loop cleanly on ^C so we get to report
+   memset(&sa, 0, sizeof(sa));
+   sa.sa_handler = stop_running;
+   sigaction(SIGINT, &sa, NULL);
+   sigaction(SIGTERM, &sa, NULL);
+   sa.sa_handler = reset_trips;
+   sigaction(SIGUSR2, &sa, NULL);
+#ifdef PROF
+   sa.sa_handler = prof_request;
+   sigaction(SIGUSR1, &sa, NULL);
+#endif
+
+   sink->start();
+
+   if (benchfile != NULL) {
+      ret = bench_file(benchfile, bench_scale);
+      sink->stop(NULL);
+   } else if (logfile != NULL) {
+      ret = replay_file(logfile, speed, from, to);
+      if (ret)
+	 sink->stop(NULL);
+   } else {
+#ifdef PROF
+      prof_live = 1;
+#endif
+      for (i = 0; i < nbuses; i++)
+	 net_init(buses[i]);
+
+      receive_start();
+      if (playfile != NULL && play_start(playfile, speed)) {
+	 receive_stop();
+	 sink->stop(NULL);
+	 return 1;
+      }
+      decode_loop();
+      if (player != NULL)
+	 play_stop();
+
+      sink->stop(NULL);
+      print_recv_stats();
+      if (player != NULL)
+	 play_report(stderr);
+      report_buses(stderr);
+      ret = 0;
+   }
+
+   for (i = 0; i < nbuses; i++) {
+      if (record_close(buses[i]))
+	 ret = 1;
+      shm_close(buses[i]);
+   }
+   return ret;
 }
@@ -0,0 +1,62 @@
+// layout of the shared memory segment ScoobyCAN publishes its values in
+// (-m NAME, then /dev/shm/NAME), see doc/Shared_memory.md
+#ifndef SCOOBYCAN_SHM_H
+#define SCOOBYCAN_SHM_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define SCOOBY_SHM_MAGIC "SCSH"
+#define SCOOBY_SHM_VERSION 1
+// room for this many values per kind, and for names of this length
+#define SCOOBY_SHM_SLOTS 32
+#define SCOOBY_SHM_NAME 16
+
+// the values, only ever read under the seqlock
+struct scooby_shm_values {
+   uint64_t stamp_us;      // timestamp of the latest decoded frame
+   uint64_t frames;        // decoded frames so far
+   int32_t ints[SCOOBY_SHM_SLOTS];
+   float floats[SCOOBY_SHM_SLOTS];
+   float aux[SCOOBY_SHM_SLOTS];
+   uint8_t switches[SCOOBY_SHM_SLOTS];
+   // when each value was last decoded or changed, frame time in us
+   uint64_t ints_us[SCOOBY_SHM_SLOTS];
+   uint64_t floats_us[SCOOBY_SHM_SLOTS];
+   uint64_t aux_us[SCOOBY_SHM_SLOTS];
+   uint64_t switches_us[SCOOBY_SHM_SLOTS];
+};
+
+struct scooby_shm {
+   // written once before anything else
+   char magic[4];
+   uint32_t version;
+   uint32_t size;          // sizeof(struct scooby_shm)
+   int32_t pid;            // of the writer, 0 once it has gone
+   char bus[SCOOBY_SHM_NAME];
+   uint32_t n_ints, n_floats, n_aux, n_switches;
+   char int_names[SCOOBY_SHM_SLOTS][SCOOBY_SHM_NAME];
+   char float_names[SCOOBY_SHM_SLOTS][SCOOBY_SHM_NAME];
+   char aux_names[SCOOBY_SHM_SLOTS][SCOOBY_SHM_NAME];
+   char switch_names[SCOOBY_SHM_SLOTS][SCOOBY_SHM_NAME];
+   // odd while the writer is busy, bumped twice per update
+   uint32_t seq __attribute__((aligned(64)));
+   struct scooby_shm_values v __attribute__((aligned(64)));
+};
+
+// take a consistent copy of the values, this retries while the writer is
+// busy and never blocks it
+static inline void scooby_shm_read(const struct scooby_shm *m,
+      struct scooby_shm_values *v)
+{
+   uint32_t seq;
+
+   do {
+      while ((seq = __atomic_load_n(&m->seq, __ATOMIC_ACQUIRE)) & 1)
+	 ;
+      memcpy(v, (const void *) &m->v, sizeof(*v));
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+   } while (__atomic_load_n(&m->seq, __ATOMIC_RELAXED) != seq);
+}
+
+#endif